@@ -0,0 +1,437 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include "alloc.h"
+
+enum backend {
+    BACKEND_SYSTEM,
+    BACKEND_ARENA,
+    BACKEND_POOL
+};
+
+// alignment of blocks in the region, the same as malloc's
+#define ALLOC_ALIGNMENT 16
+
+// every class of the pool has 2^POOL_PART_SHIFT bytes of the region
+#define POOL_PART_SHIFT 32
+
+_Static_assert(((size_t) ALLOC_POOL_CLASSES << POOL_PART_SHIFT) <= ALLOC_REGION_SIZE,
+               "pool classes don't fit in the region");
+_Static_assert(ALLOC_POOL_MIN_SIZE << (ALLOC_POOL_CLASSES - 1) == ALLOC_POOL_MAX_SIZE,
+               "size classes don't match the maximum size");
+
+// 0 - not initialized, 1 - being initialized, 2 - ready
+static _Atomic int state;
+static enum backend backend;
+
+// region of arena and pool, NULL for the system backend
+static char *region;
+static _Atomic size_t arena_used;
+static _Atomic size_t pool_used[ALLOC_POOL_CLASSES];
+// freed blocks of every class, linked through their first bytes
+static _Thread_local void *pool_free_lists[ALLOC_POOL_CLASSES];
+
+#ifdef ALLOC_STATS
+
+static const char *backend_names[] = {"system", "arena", "pool"};
+
+// counters of a single call site
+struct site_stats {
+    _Atomic (const char*) site;
+    _Atomic size_t allocs;
+    _Atomic size_t reallocs;
+    // reallocs that moved the block, and bytes they copied
+    _Atomic size_t moves;
+    _Atomic size_t copied;
+    // requested bytes (new sizes of reallocs included)
+    _Atomic size_t bytes;
+};
+
+// the last one counts sites that didn't fit in the table
+static struct site_stats sites[ALLOC_MAX_SITES + 1];
+
+static _Atomic size_t frees;
+static _Atomic size_t live;
+static _Atomic size_t peak;
+// bucket i counts requested sizes in [2^(i-1), 2^i), bucket 0 counts empty allocations
+static _Atomic size_t histogram[65];
+
+static struct site_stats* find_site (const char *site) {
+
+    size_t index = (size_t) (((uintptr_t) site >> 3) * 0x9E3779B97F4A7C15u) % ALLOC_MAX_SITES;
+
+    for (int i = 0; i < ALLOC_MAX_SITES; i++) {
+        const char *current = atomic_load_explicit(&sites[index].site, memory_order_acquire);
+
+        if (current == site)
+            return &sites[index];
+
+        if (current == NULL) {
+            const char *expected = NULL;
+            if (atomic_compare_exchange_strong(&sites[index].site, &expected, site) || expected == site)
+                return &sites[index];
+        }
+
+        index = (index + 1) % ALLOC_MAX_SITES;
+    }
+
+    return &sites[ALLOC_MAX_SITES];
+}
+
+static void count_size (size_t size) {
+    int bucket = size == 0 ? 0 : 64 - __builtin_clzll((unsigned long long) size);
+    atomic_fetch_add_explicit(&histogram[bucket], 1, memory_order_relaxed);
+}
+
+// Updates live memory by 'added' - 'removed' bytes (sizes of blocks) and its peak
+static void count_live (size_t added, size_t removed) {
+
+    size_t current = atomic_fetch_add_explicit(&live, added - removed, memory_order_relaxed) + added - removed;
+    size_t maximum = atomic_load_explicit(&peak, memory_order_relaxed);
+
+    // live memory may "drop below zero" if foreign pointers are freed, such values are ignored
+    while (current <= ALLOC_REGION_SIZE * 4 && current > maximum
+           && !atomic_compare_exchange_weak(&peak, &maximum, current));
+}
+
+static int site_cmp_by_bytes (const void *a, const void *b) {
+
+    const struct site_stats *s1 = *(const struct site_stats **) a;
+    const struct site_stats *s2 = *(const struct site_stats **) b;
+
+    if (s1->bytes != s2->bytes)
+        return s1->bytes < s2->bytes ? 1 : -1;
+    return 0;
+}
+
+static void print_stats (void) {
+
+    static struct site_stats *sorted[ALLOC_MAX_SITES + 1];
+    size_t used = 0, allocs = 0, reallocs = 0, moves = 0, bytes = 0;
+
+    for (int i = 0; i <= ALLOC_MAX_SITES; i++) {
+        if (sites[i].allocs + sites[i].reallocs == 0)
+            continue;
+
+        sorted[used++] = &sites[i];
+        allocs += sites[i].allocs;
+        reallocs += sites[i].reallocs;
+        moves += sites[i].moves;
+        bytes += sites[i].bytes;
+    }
+
+    qsort(sorted, used, sizeof (struct site_stats*), site_cmp_by_bytes);
+
+    fprintf(stderr, "allocation stats (backend: %s)\n", backend_names[backend]);
+    fprintf(stderr, "  allocs: %zu, reallocs: %zu (moved: %zu), frees: %zu, bytes: %zu, peak live: %zu\n",
+            allocs, reallocs, moves, (size_t) frees, bytes, (size_t) peak);
+
+    fprintf(stderr, "%-40s %12s %12s %12s %14s %16s\n", "call site", "allocs", "reallocs", "moved",
+            "copied bytes", "bytes");
+    for (size_t i = 0; i < used; i++) {
+        const char *site = sorted[i] == &sites[ALLOC_MAX_SITES] ? "(other)" : (const char*) sorted[i]->site;
+        // build systems may pass absolute paths, only names of files are printed
+        if (strrchr(site, '/') != NULL)
+            site = strrchr(site, '/') + 1;
+        fprintf(stderr, "%-40s %12zu %12zu %12zu %14zu %16zu\n", site, (size_t) sorted[i]->allocs,
+                (size_t) sorted[i]->reallocs, (size_t) sorted[i]->moves, (size_t) sorted[i]->copied,
+                (size_t) sorted[i]->bytes);
+    }
+
+    fprintf(stderr, "%-40s %12s\n", "requested size", "count");
+    for (int i = 0; i <= 64; i++) {
+        if (histogram[i] == 0)
+            continue;
+
+        char range[64];
+        if (i == 0)
+            snprintf(range, sizeof (range), "0");
+        else
+            snprintf(range, sizeof (range), "%zu - %zu", (size_t) 1 << (i - 1),
+                     i == 64 ? SIZE_MAX : ((size_t) 1 << i) - 1);
+        fprintf(stderr, "%-40s %12zu\n", range, (size_t) histogram[i]);
+    }
+}
+
+#endif // ALLOC_STATS
+
+static void init (void) {
+
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(&state, &expected, 1)) {
+        // other thread is initializing the layer
+        while (atomic_load_explicit(&state, memory_order_acquire) != 2);
+        return;
+    }
+
+    backend = BACKEND_SYSTEM;
+    const char *name = getenv("ALLOC_BACKEND");
+
+    if (name != NULL && (strcmp(name, "arena") == 0 || strcmp(name, "pool") == 0)) {
+        // MAP_NORESERVE: pages are allocated on first touch
+        void *p = mmap(NULL, ALLOC_REGION_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (p != MAP_FAILED) {
+            region = (char*) p;
+            backend = strcmp(name, "arena") == 0 ? BACKEND_ARENA : BACKEND_POOL;
+        }
+    }
+
+#ifdef ALLOC_STATS
+    atexit(print_stats);
+#endif
+
+    atomic_store_explicit(&state, 2, memory_order_release);
+}
+
+static bool in_region (const void *ptr) {
+    return region != NULL && (const char*) ptr >= region && (const char*) ptr < region + ALLOC_REGION_SIZE;
+}
+
+static int pool_class (size_t size) {
+    if (size <= ALLOC_POOL_MIN_SIZE)
+        return 0;
+    return 64 - __builtin_clzll((unsigned long long) (size - 1)) - __builtin_ctz(ALLOC_POOL_MIN_SIZE);
+}
+
+// Arena blocks are preceded by their size, pool blocks have the size of their class
+static size_t block_size (void *ptr) {
+
+    if (!in_region(ptr))
+        return malloc_usable_size(ptr);
+
+    if (backend == BACKEND_ARENA)
+        return *(size_t*) ((char*) ptr - ALLOC_ALIGNMENT);
+
+    return (size_t) ALLOC_POOL_MIN_SIZE << (((char*) ptr - region) >> POOL_PART_SHIFT);
+}
+
+static void* arena_alloc (size_t size) {
+
+    size_t total = ALLOC_ALIGNMENT + (size + ALLOC_ALIGNMENT - 1) / ALLOC_ALIGNMENT * ALLOC_ALIGNMENT;
+    size_t offset = atomic_fetch_add_explicit(&arena_used, total, memory_order_relaxed);
+
+    if (total > ALLOC_REGION_SIZE || offset > ALLOC_REGION_SIZE - total)
+        exit(EXIT_FAILURE);
+
+    char *block = region + offset + ALLOC_ALIGNMENT;
+    *(size_t*) (block - ALLOC_ALIGNMENT) = size;
+    return block;
+}
+
+static void* pool_alloc (size_t size) {
+
+    if (size > ALLOC_POOL_MAX_SIZE)
+        return malloc(size);
+
+    int class = pool_class(size);
+    void *block = pool_free_lists[class];
+
+    if (block != NULL) {
+        pool_free_lists[class] = *(void**) block;
+        return block;
+    }
+
+    size_t class_size = (size_t) ALLOC_POOL_MIN_SIZE << class;
+    size_t offset = atomic_fetch_add_explicit(&pool_used[class], class_size, memory_order_relaxed);
+
+    if (offset > ((size_t) 1 << POOL_PART_SHIFT) - class_size)
+        exit(EXIT_FAILURE);
+
+    return region + ((size_t) class << POOL_PART_SHIFT) + offset;
+}
+
+static void pool_free (void *ptr) {
+    int class = (int) (((char*) ptr - region) >> POOL_PART_SHIFT);
+    *(void**) ptr = pool_free_lists[class];
+    pool_free_lists[class] = ptr;
+}
+
+void* alloc_malloc (size_t size, const char *site) {
+
+    if (atomic_load_explicit(&state, memory_order_acquire) != 2)
+        init();
+
+    void *p;
+    switch (backend) {
+        case BACKEND_ARENA:
+            p = arena_alloc(size);
+            break;
+
+        case BACKEND_POOL:
+            p = pool_alloc(size);
+            break;
+
+        default:
+            p = malloc(size);
+            break;
+    }
+
+    if (size > 0 && p == NULL)
+        exit(EXIT_FAILURE);
+
+#ifdef ALLOC_STATS
+    struct site_stats *stats = find_site(site);
+    atomic_fetch_add_explicit(&stats->allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->bytes, size, memory_order_relaxed);
+    count_size(size);
+    if (p != NULL)
+        count_live(block_size(p), 0);
+#else
+    (void) site;
+#endif
+
+    return p;
+}
+
+void* alloc_realloc (void *ptr, size_t size, const char *site) {
+
+    if (ptr == NULL)
+        return alloc_malloc(size, site);
+
+#ifdef ALLOC_STATS
+    size_t old_size = block_size(ptr);
+#endif
+
+    void *p;
+    if (!in_region(ptr)) {
+        p = realloc(ptr, size);
+    }
+    else if (size <= block_size(ptr)) {
+        // blocks of the region never shrink
+        p = ptr;
+    }
+    else {
+        p = backend == BACKEND_ARENA ? arena_alloc(size) : pool_alloc(size);
+        if (p != NULL) {
+            memcpy(p, ptr, block_size(ptr));
+            if (backend == BACKEND_POOL)
+                pool_free(ptr);
+        }
+    }
+
+    if (size > 0 && p == NULL)
+        exit(EXIT_FAILURE);
+
+#ifdef ALLOC_STATS
+    struct site_stats *stats = find_site(site);
+    atomic_fetch_add_explicit(&stats->reallocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->bytes, size, memory_order_relaxed);
+    if (p != ptr) {
+        atomic_fetch_add_explicit(&stats->moves, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stats->copied, old_size < size ? old_size : size, memory_order_relaxed);
+    }
+    count_size(size);
+    count_live(p != NULL ? block_size(p) : 0, old_size);
+#else
+    (void) site;
+#endif
+
+    return p;
+}
+
+void alloc_free (void *ptr) {
+
+    if (ptr == NULL)
+        return;
+
+#ifdef ALLOC_STATS
+    atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+    count_live(0, block_size(ptr));
+#endif
+
+    if (!in_region(ptr))
+        free(ptr);
+    else if (backend == BACKEND_POOL)
+        pool_free(ptr);
+}
+
+void* alloc_aligned (size_t alignment, size_t size, const char *site) {
+
+    if (atomic_load_explicit(&state, memory_order_acquire) != 2)
+        init();
+
+    void *p = aligned_alloc(alignment, size);
+
+    if (size > 0 && p == NULL)
+        exit(EXIT_FAILURE);
+
+#ifdef ALLOC_STATS
+    struct site_stats *stats = find_site(site);
+    atomic_fetch_add_explicit(&stats->allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->bytes, size, memory_order_relaxed);
+    count_size(size);
+    if (p != NULL)
+        count_live(block_size(p), 0);
+#else
+    (void) site;
+#endif
+
+    return p;
+}
+
+void* alloc_reserve (size_t size, const char *site) {
+
+    if (atomic_load_explicit(&state, memory_order_acquire) != 2)
+        init();
+
+    // MAP_NORESERVE: memory isn't accounted until it's actually used
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (p == MAP_FAILED)
+        exit(EXIT_FAILURE);
+
+#ifdef ALLOC_STATS
+    // reserved bytes count as live, even though untouched pages don't use memory
+    struct site_stats *stats = find_site(site);
+    atomic_fetch_add_explicit(&stats->allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->bytes, size, memory_order_relaxed);
+    count_size(size);
+    count_live(size, 0);
+#else
+    (void) site;
+#endif
+
+    return p;
+}
+
+void* alloc_reserve_resize (void *ptr, size_t old_size, size_t new_size, const char *site) {
+
+    void *p = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE);
+
+    if (p == MAP_FAILED)
+        exit(EXIT_FAILURE);
+
+#ifdef ALLOC_STATS
+    // a moved mapping keeps its pages, so nothing is counted as copied
+    struct site_stats *stats = find_site(site);
+    atomic_fetch_add_explicit(&stats->reallocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->bytes, new_size, memory_order_relaxed);
+    if (p != ptr)
+        atomic_fetch_add_explicit(&stats->moves, 1, memory_order_relaxed);
+    count_size(new_size);
+    count_live(new_size, old_size);
+#else
+    (void) site;
+#endif
+
+    return p;
+}
+
+void alloc_reserve_free (void *ptr, size_t size) {
+
+#ifdef ALLOC_STATS
+    atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+    count_live(0, size);
+#endif
+
+    munmap(ptr, size);
+}
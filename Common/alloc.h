@@ -0,0 +1,58 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+// Allocation layer shared by both projects (behind Task1's safe_malloc and Task2's safeMalloc).
+//
+// Every allocation exits the program with code 1 if there is no memory available.
+// Memory is served by one of the backends, chosen by the ALLOC_BACKEND environment variable
+// before the first allocation:
+//   system - malloc/realloc/free (default)
+//   arena  - bump allocation from one reserved region, free does nothing
+//   pool   - thread-local free lists of size classes up to ALLOC_POOL_MAX_SIZE bytes,
+//            bigger blocks come from malloc
+// If the region of arena or pool can't be reserved, the system backend is used.
+// Pointers that didn't come from the layer (e.g. arrays malloc'd by a user of the library)
+// may be passed to 'alloc_free' and 'alloc_realloc', they are handed to the system allocator.
+//
+// Besides, there are two kinds of blocks that always bypass the backends:
+// aligned blocks (from aligned_alloc, freed with 'alloc_free' like any other block)
+// and reservations of address space for big arrays (anonymous mappings, pages are allocated
+// on first touch, so reserving more than needed is cheap, and resizing moves pages
+// instead of copying the data).
+//
+// If compiled with ALLOC_STATS defined, the layer counts allocations, bytes and moving reallocs
+// of every call site, peak of live memory and a histogram of sizes (powers of 2),
+// which are printed to stderr at exit.
+
+// call site of allocation, as a string literal "file:line"
+#define ALLOC_STRINGIFY(x) #x
+#define ALLOC_LINE(line) ALLOC_STRINGIFY(line)
+#define ALLOC_SITE (__FILE__ ":" ALLOC_LINE(__LINE__))
+
+// size of the region reserved for arena and pool backends
+#define ALLOC_REGION_SIZE ((size_t) 1 << 36)
+
+// size classes of the pool are powers of 2 from ALLOC_POOL_MIN_SIZE to ALLOC_POOL_MAX_SIZE,
+// each of them has its own part of the region
+#define ALLOC_POOL_MIN_SIZE 16
+#define ALLOC_POOL_MAX_SIZE 4096
+#define ALLOC_POOL_CLASSES 9
+
+// maximum number of call sites with separate counters, the rest is counted together
+#define ALLOC_MAX_SITES 1024
+
+void* alloc_malloc (size_t size, const char *site);
+void* alloc_realloc (void *ptr, size_t size, const char *site);
+void alloc_free (void *ptr);
+
+// 'size' has to be a multiple of 'alignment'
+void* alloc_aligned (size_t alignment, size_t size, const char *site);
+
+// 'size' has to be positive, reservations are freed only with 'alloc_reserve_free'
+void* alloc_reserve (size_t size, const char *site);
+void* alloc_reserve_resize (void *ptr, size_t old_size, size_t new_size, const char *site);
+void alloc_reserve_free (void *ptr, size_t size);
+
+#endif // ALLOC_H
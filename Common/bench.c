@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char *event_names[BENCH_EVENTS] = {
+    "cycles/op", "instr/op", "L1d-miss/op", "LLC-miss/op", "br-miss/op"
+};
+
+static uint64_t now (void) {
+
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000u + (uint64_t) time.tv_nsec;
+}
+
+#ifdef __linux__
+
+// Opens counter of given event for the calling thread (user space only), returns -1 on failure
+static int open_counter (enum bench_event event) {
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // counters may be multiplexed if there are not enough of them, values are then scaled
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (event) {
+        case BENCH_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+
+        case BENCH_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+
+        case BENCH_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+
+        case BENCH_LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+
+        default:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+    }
+
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// Reads value, time enabled and time running of the counter
+static bool read_counter (int fd, uint64_t values[3]) {
+    return read(fd, values, 3 * sizeof (uint64_t)) == 3 * sizeof (uint64_t);
+}
+
+#else
+
+static int open_counter (enum bench_event event) {
+    (void) event;
+    return -1;
+}
+
+static bool read_counter (int fd, uint64_t values[3]) {
+    (void) fd;
+    (void) values;
+    return false;
+}
+
+#endif
+
+void bench_init (Bench *bench, const char *name) {
+
+    bench->name = name;
+    bench->nanoseconds = 0;
+    bench->ops = 0;
+
+    for (int i = 0; i < BENCH_EVENTS; i++) {
+        bench->fds[i] = open_counter(i);
+        bench->counts[i] = 0;
+    }
+}
+
+void bench_free (Bench *bench) {
+    for (int i = 0; i < BENCH_EVENTS; i++) {
+        if (bench->fds[i] >= 0)
+            close(bench->fds[i]);
+    }
+}
+
+void bench_start (Bench *bench) {
+
+    for (int i = 0; i < BENCH_EVENTS; i++) {
+        if (bench->fds[i] >= 0 && !read_counter(bench->fds[i], bench->started[i])) {
+            close(bench->fds[i]);
+            bench->fds[i] = -1;
+        }
+    }
+
+    bench->start_time = now();
+}
+
+void bench_stop (Bench *bench, uint64_t ops) {
+
+    uint64_t end_time = now();
+    bench->nanoseconds += end_time - bench->start_time;
+    bench->ops += ops;
+
+    for (int i = 0; i < BENCH_EVENTS; i++) {
+        uint64_t values[3];
+
+        if (bench->fds[i] < 0)
+            continue;
+
+        if (!read_counter(bench->fds[i], values)) {
+            close(bench->fds[i]);
+            bench->fds[i] = -1;
+            continue;
+        }
+
+        double count = (double) (values[0] - bench->started[i][0]);
+        uint64_t enabled = values[1] - bench->started[i][1];
+        uint64_t running = values[2] - bench->started[i][2];
+        if (running != 0 && running < enabled)
+            count *= (double) enabled / running;
+
+        bench->counts[i] += count;
+    }
+}
+
+void bench_report_header (FILE *out) {
+
+    if (fprintf(out, "%-32s %12s %10s", "benchmark", "ops", "ns/op") < 0)
+        exit(EXIT_FAILURE);
+
+    for (int i = 0; i < BENCH_EVENTS; i++) {
+        if (fprintf(out, " %12s", event_names[i]) < 0)
+            exit(EXIT_FAILURE);
+    }
+
+    if (fprintf(out, "\n") < 0)
+        exit(EXIT_FAILURE);
+}
+
+void bench_report (const Bench *bench, FILE *out) {
+
+    double ops = bench->ops != 0 ? (double) bench->ops : 1;
+
+    if (fprintf(out, "%-32s %12llu %10.2f", bench->name, (unsigned long long) bench->ops,
+                bench->nanoseconds / ops) < 0)
+        exit(EXIT_FAILURE);
+
+    for (int i = 0; i < BENCH_EVENTS; i++) {
+        int result = bench->fds[i] >= 0 ? fprintf(out, " %12.3f", bench->counts[i] / ops)
+                                        : fprintf(out, " %12s", "n/a");
+        if (result < 0)
+            exit(EXIT_FAILURE);
+    }
+
+    if (fprintf(out, "\n") < 0)
+        exit(EXIT_FAILURE);
+}
+
+void bench_use (uint64_t value) {
+    static volatile uint64_t sink;
+    sink ^= value;
+}
@@ -0,0 +1,65 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Benchmark harness shared by both projects.
+// Hardware counters are read with perf_event_open (Linux), counters that can't be opened
+// (no permission, no PMU in a virtual machine, other systems) are reported as "n/a",
+// wall time from clock_gettime is always measured.
+
+// hardware events counted by every benchmark
+enum bench_event {
+    BENCH_CYCLES,
+    BENCH_INSTRUCTIONS,
+    BENCH_L1D_MISSES,
+    BENCH_LLC_MISSES,
+    BENCH_BRANCH_MISSES,
+    BENCH_EVENTS
+};
+
+// single benchmark, measured over any number of start/stop pairs
+// (so that preparing the data isn't counted)
+struct bench {
+
+    const char *name;
+
+    // descriptors of counters, -1 if the event is unavailable
+    int fds[BENCH_EVENTS];
+    // values summed over all the measured intervals (scaled if counters were multiplexed)
+    double counts[BENCH_EVENTS];
+    // values at the start of the current interval
+    uint64_t started[BENCH_EVENTS][3];
+
+    uint64_t nanoseconds;
+    uint64_t start_time;
+    // number of operations done in the measured intervals
+    uint64_t ops;
+};
+
+typedef struct bench Bench;
+
+// Inits the benchmark and opens its counters
+void bench_init (Bench *bench, const char *name);
+
+// Closes the counters
+void bench_free (Bench *bench);
+
+// Starts the measured interval
+void bench_start (Bench *bench);
+
+// Ends the measured interval, in which 'ops' operations were done
+void bench_stop (Bench *bench, uint64_t ops);
+
+// Prints the header of the table written by 'bench_report'
+void bench_report_header (FILE *out);
+
+// Prints ns/op, cycles/op, instructions/op and misses per op as a single line of the table
+void bench_report (const Bench *bench, FILE *out);
+
+// Keeps the compiler from optimizing away the computation of 'value'
+void bench_use (uint64_t value);
+
+#endif // BENCH_H
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+struct trace_event {
+    uint64_t time;
+    const char *name;
+    long long value;
+    // 'B' - begin, 'E' - end, 'C' - counter, 'M' - name of thread
+    char phase;
+};
+
+typedef struct trace_event TraceEvent;
+
+struct trace_chunk {
+    struct trace_chunk *next;
+    int size;
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+};
+
+// buffer of events of a single thread, only the owner writes to it
+struct trace_thread {
+    struct trace_thread *next;
+    long tid;
+    struct trace_chunk *first;
+    struct trace_chunk *last;
+};
+
+// 0 - not initialized, 1 - being initialized, 2 - ready
+static _Atomic int state;
+static bool enabled;
+static const char *path;
+static uint64_t start_time;
+
+// buffers of all threads that recorded anything, pushed without locks
+static struct trace_thread *_Atomic threads;
+static _Thread_local struct trace_thread *current;
+
+static uint64_t now (void) {
+
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000u + (uint64_t) time.tv_nsec;
+}
+
+// Writes all the events, threads that are still running shouldn't record anything at this point
+static void write_trace (void) {
+
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+        return;
+
+    long pid = (long) getpid();
+    bool first = true;
+    fprintf(out, "{\"traceEvents\":[");
+
+    for (struct trace_thread *thread = atomic_load(&threads); thread != NULL; thread = thread->next) {
+        for (struct trace_chunk *chunk = thread->first; chunk != NULL; chunk = chunk->next) {
+            for (int i = 0; i < chunk->size; i++) {
+                const TraceEvent *event = &chunk->events[i];
+
+                fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%ld,\"tid\":%ld",
+                        first ? "" : ",", event->phase == 'M' ? "thread_name" : event->name,
+                        event->phase, pid, thread->tid);
+                first = false;
+
+                if (event->phase == 'M')
+                    fprintf(out, ",\"args\":{\"name\":\"%s\"}}", event->name);
+                else if (event->phase == 'C')
+                    fprintf(out, ",\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                            (event->time - start_time) / 1000.0, event->value);
+                else
+                    fprintf(out, ",\"ts\":%.3f}", (event->time - start_time) / 1000.0);
+            }
+        }
+    }
+
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    fclose(out);
+}
+
+static void init (void) {
+
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(&state, &expected, 1)) {
+        // other thread is initializing the tracer
+        while (atomic_load_explicit(&state, memory_order_acquire) != 2);
+        return;
+    }
+
+    path = getenv("TRACE_FILE");
+    enabled = path != NULL && path[0] != '\0';
+
+    if (enabled) {
+        start_time = now();
+        atexit(write_trace);
+    }
+
+    atomic_store_explicit(&state, 2, memory_order_release);
+}
+
+bool trace_enabled (void) {
+
+    if (atomic_load_explicit(&state, memory_order_acquire) != 2)
+        init();
+
+    return enabled;
+}
+
+static struct trace_chunk* new_chunk (void) {
+
+    struct trace_chunk *chunk = (struct trace_chunk*) malloc(sizeof (struct trace_chunk));
+    if (chunk == NULL)
+        exit(EXIT_FAILURE);
+
+    chunk->next = NULL;
+    chunk->size = 0;
+    return chunk;
+}
+
+// Creates buffer of the calling thread and adds it to the list of all buffers
+static struct trace_thread* register_thread (void) {
+
+    struct trace_thread *thread = (struct trace_thread*) malloc(sizeof (struct trace_thread));
+    if (thread == NULL)
+        exit(EXIT_FAILURE);
+
+    thread->tid = (long) syscall(SYS_gettid);
+    thread->first = thread->last = new_chunk();
+    thread->next = atomic_load(&threads);
+    while (!atomic_compare_exchange_weak(&threads, &thread->next, thread));
+
+    return current = thread;
+}
+
+static void record (char phase, const char *name, long long value) {
+
+    if (!trace_enabled())
+        return;
+
+    struct trace_thread *thread = current != NULL ? current : register_thread();
+
+    if (thread->last->size == TRACE_CHUNK_EVENTS) {
+        thread->last->next = new_chunk();
+        thread->last = thread->last->next;
+    }
+
+    thread->last->events[thread->last->size++] = (TraceEvent) {
+        .time = now(), .name = name, .value = value, .phase = phase
+    };
+}
+
+void trace_begin (const char *name) {
+    record('B', name, 0);
+}
+
+void trace_end (const char *name) {
+    record('E', name, 0);
+}
+
+void trace_counter (const char *name, long long value) {
+    record('C', name, value);
+}
+
+void trace_memory (void) {
+
+    if (!trace_enabled())
+        return;
+
+    // second number is the resident set, in pages
+    long size, resident;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return;
+
+    if (fscanf(statm, "%ld %ld", &size, &resident) == 2)
+        trace_counter("memory", (long long) resident * sysconf(_SC_PAGESIZE));
+    fclose(statm);
+}
+
+void trace_thread_name (const char *name) {
+    record('M', name, 0);
+}
@@ -0,0 +1,35 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+// Tracer writing Chrome/Perfetto trace-event JSON (chrome://tracing, ui.perfetto.dev).
+//
+// Tracing is enabled by the TRACE_FILE environment variable, holding the path of the output.
+// Otherwise every function below returns at once.
+// Events are kept in memory, in buffers owned by their threads (so recording needs no locks),
+// and written to the file at exit. Names of events have to be string literals
+// (only pointers are stored) without characters that need escaping in JSON.
+
+// number of events in a single chunk of a thread's buffer
+#define TRACE_CHUNK_EVENTS 4096
+
+// Checks if tracing is enabled
+bool trace_enabled (void);
+
+// Begins a span of the calling thread, spans have to be nested
+void trace_begin (const char *name);
+
+// Ends the innermost span of the calling thread
+void trace_end (const char *name);
+
+// Records value of a counter
+void trace_counter (const char *name, long long value);
+
+// Records the resident memory of the process as the "memory" counter
+void trace_memory (void);
+
+// Names the calling thread in the trace
+void trace_thread_name (const char *name);
+
+#endif // TRACE_H
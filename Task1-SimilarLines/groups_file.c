@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "groups_file.h"
+
+void groups_file_store32 (unsigned char *dst, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        dst[i] = (unsigned char) (value >> (8 * i));
+}
+
+void groups_file_store64 (unsigned char *dst, uint64_t value) {
+    for (int i = 0; i < 8; i++)
+        dst[i] = (unsigned char) (value >> (8 * i));
+}
+
+uint32_t groups_file_load32 (const unsigned char *src) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t) src[i] << (8 * i);
+    return value;
+}
+
+uint64_t groups_file_load64 (const unsigned char *src) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= (uint64_t) src[i] << (8 * i);
+    return value;
+}
+
+bool groups_file_from_memory (GroupsFile *file, const void *data, size_t size) {
+
+    file->data = (const unsigned char*) data;
+    file->size = size;
+    file->mapped = false;
+
+    if (size < GROUPS_FILE_HEADER_SIZE || memcmp(file->data, GROUPS_FILE_MAGIC, 4) != 0
+        || groups_file_load32(file->data + 4) != GROUPS_FILE_VERSION)
+        return false;
+
+    file->groups = groups_file_load64(file->data + 8);
+    file->members = groups_file_load64(file->data + 16);
+
+    // checked separately, so that corrupted counts can't overflow
+    size_t arrays = (size - GROUPS_FILE_HEADER_SIZE) / 4;
+    if ((size - GROUPS_FILE_HEADER_SIZE) % 4 != 0 || file->groups > arrays
+        || file->members != arrays - file->groups)
+        return false;
+
+    file->sizes = file->data + GROUPS_FILE_HEADER_SIZE;
+    file->numbers = file->sizes + 4 * file->groups;
+
+    // sizes have to cover all the members, so that iterating never leaves the file
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < file->groups; i++)
+        total += groups_file_size(file, i);
+
+    return total == file->members;
+}
+
+bool groups_file_open (GroupsFile *file, const char *path) {
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < GROUPS_FILE_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t) info.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    if (!groups_file_from_memory(file, data, size)) {
+        munmap(data, size);
+        return false;
+    }
+
+    file->mapped = true;
+    return true;
+}
+
+void groups_file_close (GroupsFile *file) {
+    if (file->mapped)
+        munmap((void*) file->data, file->size);
+    file->mapped = false;
+}
+
+uint32_t groups_file_size (const GroupsFile *file, uint64_t group) {
+    return groups_file_load32(file->sizes + 4 * group);
+}
+
+uint32_t groups_file_member (const GroupsFile *file, uint64_t member) {
+    return groups_file_load32(file->numbers + 4 * member);
+}
+
+void groups_cursor_init (GroupsCursor *cursor) {
+    cursor->group = 0;
+    cursor->member = 0;
+}
+
+bool groups_cursor_next (const GroupsFile *file, GroupsCursor *cursor, uint32_t *size, uint64_t *first) {
+
+    if (cursor->group == file->groups)
+        return false;
+
+    *size = groups_file_size(file, cursor->group);
+    *first = cursor->member;
+
+    cursor->group++;
+    cursor->member += *size;
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef GROUPS_FILE_H
+#define GROUPS_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary output of similar_lines (--format=binary), all numbers are little-endian:
+//   offset  0: magic "SLGR"
+//   offset  4: uint32 version
+//   offset  8: uint64 number of groups
+//   offset 16: uint64 number of members (sum of sizes of all groups)
+//   offset 24: uint32 sizes of groups
+//   then:      uint32 numbers of lines (counted from 1), group after group
+// Groups are in the same order as in the text output. Every array is 4-byte aligned,
+// so a mapped file can be read in place.
+#define GROUPS_FILE_MAGIC "SLGR"
+#define GROUPS_FILE_VERSION 1
+#define GROUPS_FILE_HEADER_SIZE 24
+
+// Little-endian encoding, independent of the byte order of the machine
+void groups_file_store32 (unsigned char *dst, uint32_t value);
+void groups_file_store64 (unsigned char *dst, uint64_t value);
+uint32_t groups_file_load32 (const unsigned char *src);
+uint64_t groups_file_load64 (const unsigned char *src);
+
+// Groups read from a file (mapped) or from memory, nothing is copied
+struct groups_file {
+
+    const unsigned char *data;
+    size_t size;
+    // true if 'data' was mapped by 'groups_file_open'
+    bool mapped;
+
+    uint64_t groups;
+    uint64_t members;
+    // arrays inside 'data'
+    const unsigned char *sizes;
+    const unsigned char *numbers;
+};
+
+typedef struct groups_file GroupsFile;
+
+// position of the next group while iterating
+struct groups_cursor {
+    uint64_t group;
+    uint64_t member;
+};
+
+typedef struct groups_cursor GroupsCursor;
+
+// Maps the file with given path, returns false if it can't be read or isn't a valid groups file
+bool groups_file_open (GroupsFile *file, const char *path);
+
+// Reads groups from 'size' bytes of memory, which have to outlive 'file'.
+// Returns false if it isn't a valid groups file.
+bool groups_file_from_memory (GroupsFile *file, const void *data, size_t size);
+
+// Unmaps the file (if it was mapped)
+void groups_file_close (GroupsFile *file);
+
+// Number of lines in given group, 'group' has to be less than 'file->groups'
+uint32_t groups_file_size (const GroupsFile *file, uint64_t group);
+
+// Number of line with given index in the array of all members
+uint32_t groups_file_member (const GroupsFile *file, uint64_t member);
+
+// Sets the cursor at the first group
+void groups_cursor_init (GroupsCursor *cursor);
+
+// Moves to the next group, setting its size and index of its first member.
+// Returns false if there are no more groups.
+bool groups_cursor_next (const GroupsFile *file, GroupsCursor *cursor, uint32_t *size, uint64_t *first);
+
+#endif // GROUPS_FILE_H
@@ -1,190 +1,187 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <strings.h>
 #include <stdbool.h>
 #include "line_representation.h"
 #include "safe_allocs.h"
 
+// ranges of values that are sorted with insertion sort
+#define INSERTION_SORT_THRESHOLD 16
+
 // Inits an empty line structure
 void line_init(Line *line, int number) {
 
     line->number = number;
     line->capacity = 0;
+    line->bytes = 0;
+    line->last_similar = 0;
+    line->group_size = 0;
+    line->values_size = 0;
     line->str_size = 0;
-    line->ll_size = 0;
     line->size = 0;
-    line->dbl_size = 0;
-    line->ull_size = 0;
 }
 
 // Frees all the memory that was alloc'd in the structure
 void line_free(Line *line) {
 
-    if (line->str_size != 0)
-        free(line->str_array);
-    if (line->ll_size != 0)
-        free(line->ll_array);
-    if (line->ull_size != 0)
-        free(line->ull_array);
-    if (line->dbl_size != 0)
-        free(line->dbl_array);
+    if (line->values_size != 0)
+        safe_free(line->values);
     if (line->size != 0)
-        free(line->similarLines);
+        safe_free(line->similarLines);
 }
 
-// Next 4 functions add corresponding data type to line,
-// while increasing the size and capacity of dynamic array if needed.
-void add_str (Line *current, char *strValue, int *str_capacity) {
+// Adds value to line, while increasing the size and capacity of dynamic array if needed.
+void add_value (Line *current, Value value, int *values_capacity) {
 
-    if (*str_capacity == 0) {
-        current->str_array = (char**) safe_malloc(INITIAL_CAPACITY * sizeof (char*));
-        *str_capacity = INITIAL_CAPACITY;
+    if (*values_capacity == 0) {
+        current->values = (Value *) safe_malloc(INITIAL_CAPACITY * sizeof (Value));
+        *values_capacity = INITIAL_CAPACITY;
     }
-    else if (current->str_size == *str_capacity) {
-        current->str_array = (char**) safe_realloc(current->str_array, sizeof (char*) * (*str_capacity *= 2));
+    else if (current->values_size == *values_capacity) {
+        current->values = (Value *) safe_realloc(current->values, sizeof (Value) * (*values_capacity *= 2));
     }
-    current->str_array[current->str_size++] = strValue;
-}
-
-void add_ll (Line *current, long long llValue, int *ll_capacity) {
 
-    if (*ll_capacity == 0) {
-        current->ll_array = (long long *) safe_malloc(INITIAL_CAPACITY * sizeof (long long));
-        *ll_capacity = INITIAL_CAPACITY;
-    }
-    else if (current->ll_size == *ll_capacity) {
-        current->ll_array = (long long *) safe_realloc(current->ll_array, sizeof (long long) * (*ll_capacity *= 2));
-    }
+    if (value.type == VALUE_STR)
+        current->str_size++;
 
-    current->ll_array[current->ll_size++] = llValue;
+    current->values[current->values_size++] = value;
 }
 
-void add_ull (Line *current, unsigned long long ullValue, int *ull_capacity) {
+void line_set_strings (Line *current, char *strings) {
 
-    if (*ull_capacity == 0) {
-        current->ull_array = (unsigned long long *) safe_malloc(INITIAL_CAPACITY * sizeof (unsigned long long));
-        *ull_capacity = INITIAL_CAPACITY;
-    }
-    else if (current->ull_size == *ull_capacity) {
-        current->ull_array = (unsigned long long *) safe_realloc(current->ull_array, sizeof (unsigned long long) * (*ull_capacity *= 2));
+    for (int i = 0; i < current->values_size; i++) {
+        if (current->values[i].type == VALUE_STR) {
+            int len = (int) strlen(strings);
+            current->values[i].str = strings;
+            current->values[i].str_len = len;
+            strings += len + 1;
+        }
     }
-
-    current->ull_array[current->ull_size++] = ullValue;
 }
 
-void add_dbl (Line *current, double dblValue, int *dbl_capacity) {
+// Compares strings that are already folded to lowercase.
+// Gives the same order as 'strcasecmp' on the original strings.
+static inline int str_cmp (const Value *v1, const Value *v2) {
 
-    if (*dbl_capacity == 0) {
-        current->dbl_array = (double *) safe_malloc(INITIAL_CAPACITY * sizeof (double));
-        *dbl_capacity = INITIAL_CAPACITY;
-    }
-    else if (current->dbl_size == *dbl_capacity) {
-        current->dbl_array = (double *) safe_realloc(current->dbl_array, sizeof (double) * (*dbl_capacity *= 2));
-    }
+    int x = memcmp(v1->str, v2->str, (size_t) min(v1->str_len, v2->str_len));
+    if (x != 0)
+        return x;
 
-    current->dbl_array[current->dbl_size++] = dblValue;
+    return (v1->str_len > v2->str_len) - (v1->str_len < v2->str_len);
 }
 
-int case_insensitive_cmp(const void *a, const void *b) {
+// Compares values, types first (string -> long long -> unsigned long long -> double)
+// Inlined in the sorting loops below, unlike comparators passed to 'qsort'.
+static inline int value_cmp (const Value *v1, const Value *v2) {
 
-    char **aTmp = (char**)a;
-    char **bTmp = (char**)b;
+    if (v1->type != v2->type)
+        return v1->type > v2->type ? 1 : -1;
 
-    return strcasecmp(*aTmp, *bTmp);
-}
+    switch (v1->type) {
+        case VALUE_STR:
+            return str_cmp(v1, v2);
 
-int ll_cmp (const void *a, const void *b) {
+        case VALUE_LL:
+            return (v1->ll > v2->ll) - (v1->ll < v2->ll);
 
-    long long *ll1 = (long long *) a;
-    long long *ll2 = (long long *) b;
+        case VALUE_ULL:
+            return (v1->ull > v2->ull) - (v1->ull < v2->ull);
 
-    if (*ll1 > *ll2) {
-        return 1;
-    }
-    else if (*ll1 < *ll2) {
-        return -1;
-    }
-    else {
-        return 0;
+        default:
+            return (v1->dbl > v2->dbl) - (v1->dbl < v2->dbl);
     }
 }
 
-int ull_cmp (const void *a, const void *b) {
+// Checks if values are equal, in the same way as 'value_cmp'
+// (except for doubles: NaN isn't equal to anything)
+static inline bool value_equal (const Value *v1, const Value *v2) {
 
-    unsigned long long *ull1 = (unsigned long long *) a;
-    unsigned long long *ull2 = (unsigned long long *) b;
+    if (v1->type != v2->type)
+        return false;
 
-    if (*ull1 > *ull2) {
-        return 1;
-    }
-    else if (*ull1 < *ull2) {
-        return -1;
-    }
-    else {
-        return 0;
+    switch (v1->type) {
+        case VALUE_STR:
+            return v1->str_len == v2->str_len && memcmp(v1->str, v2->str, (size_t) v1->str_len) == 0;
+
+        case VALUE_DBL:
+            return v1->dbl == v2->dbl;
+
+        // long long and unsigned long long values are equal iff their bits are
+        default:
+            return v1->ull == v2->ull;
     }
 }
 
-int dbl_cmp (const void *a, const void *b) {
+static inline void swap_values (Value *v1, Value *v2) {
+    Value tmp = *v1;
+    *v1 = *v2;
+    *v2 = tmp;
+}
 
-    double *d1 = (double *) a;
-    double *d2 = (double *) b;
+// Sorts values: quicksort (median of three) for big ranges, insertion sort for the small ones.
+// Recursion goes into the smaller part, so its depth is logarithmic.
+static void sort_values (Value *values, int size) {
+
+    while (size > INSERTION_SORT_THRESHOLD) {
+        int mid = size / 2;
+
+        if (value_cmp(&values[mid], &values[0]) < 0)
+            swap_values(&values[mid], &values[0]);
+        if (value_cmp(&values[size - 1], &values[0]) < 0)
+            swap_values(&values[size - 1], &values[0]);
+        if (value_cmp(&values[size - 1], &values[mid]) < 0)
+            swap_values(&values[size - 1], &values[mid]);
+
+        Value pivot = values[mid];
+        int i = 0, j = size - 1;
+        while (i <= j) {
+            while (i < size && value_cmp(&values[i], &pivot) < 0)
+                i++;
+            while (j >= 0 && value_cmp(&values[j], &pivot) > 0)
+                j--;
+            if (i <= j) {
+                swap_values(&values[i], &values[j]);
+                i++;
+                j--;
+            }
+        }
 
-    if (*d1 > *d2) {
-        return 1;
-    }
-    else if (*d1 < *d2) {
-        return -1;
+        if (j + 1 < size - i) {
+            sort_values(values, j + 1);
+            values += i;
+            size -= i;
+        }
+        else {
+            sort_values(values + i, size - i);
+            size = j + 1;
+        }
     }
-    else {
-        return 0;
+
+    for (int i = 1; i < size; i++) {
+        Value cur = values[i];
+        int j = i - 1;
+        while (j >= 0 && value_cmp(&values[j], &cur) > 0) {
+            values[j + 1] = values[j];
+            j--;
+        }
+        values[j + 1] = cur;
     }
 }
 
 // Sorts all data that line holds
 void sort_data_in_line (Line *current) {
-
-    if (current->str_size != 0)
-        qsort(current->str_array, current->str_size, sizeof (char *), case_insensitive_cmp);
-
-    if (current->ll_size != 0)
-        qsort(current->ll_array, current->ll_size, sizeof (long long), ll_cmp);
-
-    if (current->ull_size != 0)
-        qsort(current->ull_array, current->ull_size, sizeof (unsigned long long), ull_cmp);
-
-    if (current->dbl_size != 0)
-        qsort(current->dbl_array, current->dbl_size, sizeof (double), dbl_cmp);
+    sort_values(current->values, current->values_size);
 }
 
 // Checks if two lines are similar
 // Since all data is sorted in each line, we can easily compare two lines
 bool compareLines (Line *l1, Line *l2) {
 
-    if(l1->ll_size != l2->ll_size || l1->ull_size != l2->ull_size
-       || l1->str_size != l2->str_size || l1->dbl_size != l2->dbl_size) {
-
+    if (l1->values_size != l2->values_size || l1->str_size != l2->str_size)
         return false;
-    }
 
-    for(int i = 0; i < l1->ll_size; i++) {
-        if (l1->ll_array[i] != l2->ll_array[i])
-            return false;
-    }
-
-    for(int i = 0; i < l1->ull_size; i++) {
-        if (l1->ull_array[i] != l2->ull_array[i])
-            return false;
-    }
-
-    for(int i = 0; i < l1->dbl_size; i++) {
-        if (l1->dbl_array[i] != l2->dbl_array[i])
-            return false;
-    }
-
-    for(int i = 0; i < l1->str_size; i++) {
-        if (strcasecmp(l1->str_array[i], l2->str_array[i]) != 0)
+    for (int i = 0; i < l1->values_size; i++) {
+        if (!value_equal(&l1->values[i], &l2->values[i]))
             return false;
     }
 
@@ -192,16 +189,70 @@ bool compareLines (Line *l1, Line *l2) {
 }
 
 // adding the number of similar line to the line that is passed as an argument
+// Only the difference from the previously added number is stored, 7 bits per byte
+// (the highest bit of a byte is set if the value continues in the next byte).
+// Lines in a "block" are close to each other, so most numbers take a single byte.
 void add_similar_line (Line *line, int number_of_similar) {
 
+    // 5 bytes are enough for any 'int'
     if (line->capacity == 0) {
-        line->similarLines = (int *) safe_malloc(INITIAL_CAPACITY * sizeof (int));
-        line->capacity = INITIAL_CAPACITY;
+        line->capacity = 2 * INITIAL_CAPACITY;
+        line->similarLines = (unsigned char *) safe_malloc(line->capacity * sizeof (unsigned char));
+    }
+    if (line->bytes + 5 > line->capacity) {
+        line->similarLines = (unsigned char *) safe_realloc(line->similarLines, sizeof (unsigned char) * (line->capacity *= 2));
     }
-    if (line->size == line->capacity) {
-        line->similarLines = (int *) safe_realloc(line->similarLines, sizeof (int) * (line->capacity *= 2));
+
+    unsigned int delta = (unsigned int) (number_of_similar - line->last_similar);
+    while (delta >= 0x80) {
+        line->similarLines[line->bytes++] = (unsigned char) (delta | 0x80);
+        delta >>= 7;
     }
-    line->similarLines[line->size++] = number_of_similar;
+    line->similarLines[line->bytes++] = (unsigned char) delta;
+
+    line->last_similar = number_of_similar;
+    line->size++;
+}
+
+// Decodes at most 'out_size' next numbers of similar lines to 'out', returns how many were decoded.
+// While the next 8 bytes hold single-byte differences, they are decoded all at once.
+int decode_similar_lines (const Line *line, int *offset, int *last, int *out, int out_size) {
+
+    const unsigned char *bytes = line->similarLines;
+    int pos = *offset, value = *last, decoded = 0;
+
+    while (decoded < out_size && pos < line->bytes) {
+
+        if (decoded + 8 <= out_size && pos + 8 <= line->bytes) {
+            unsigned long long word;
+            memcpy(&word, bytes + pos, sizeof (word));
+
+            if ((word & 0x8080808080808080ULL) == 0) {
+                for (int i = 0; i < 8; i++) {
+                    value += bytes[pos + i];
+                    out[decoded + i] = value;
+                }
+                pos += 8;
+                decoded += 8;
+                continue;
+            }
+        }
+
+        unsigned int delta = 0;
+        int shift = 0;
+        while (bytes[pos] & 0x80) {
+            delta |= (unsigned int) (bytes[pos++] & 0x7F) << shift;
+            shift += 7;
+        }
+        delta |= (unsigned int) bytes[pos++] << shift;
+
+        value += (int) delta;
+        out[decoded++] = value;
+    }
+
+    *offset = pos;
+    *last = value;
+    return decoded;
 }
 
 int min(int a, int b) {
@@ -211,76 +262,33 @@ int min(int a, int b) {
     return b;
 }
 
-// Compares lines by the data they contain
+// Compares lines by the data they contain, value by value
 // Data type order : string -> long long -> unsigned long long -> double
+// Only the equality of lines matters (for finding "blocks"),
+// so a shorter line is simply smaller than the one it's a prefix of.
 int line_cmp_by_data (const void *a, const void *b) {
 
     Line *l1 = (Line *) a;
     Line *l2 = (Line *) b;
 
-    // strings comparison
-    int m = min(l1->str_size, l2->str_size);
-    for(int i = 0; i < m; i++) {
-        int x = strcasecmp(l1->str_array[i], l2->str_array[i]);
+    int m = min(l1->values_size, l2->values_size);
+    for (int i = 0; i < m; i++) {
+        int x = value_cmp(&l1->values[i], &l2->values[i]);
         if (x != 0) {
             return x;
         }
     }
-    if(l1->str_size > l2->str_size) {
+    if (l1->values_size > l2->values_size) {
         return 1;
-    } else if (l1->str_size < l2->str_size) {
+    } else if (l1->values_size < l2->values_size) {
         return -1;
     }
 
-    // long long comparison
-    m = min (l1->ll_size, l2->ll_size);
-    for(int i = 0; i < m; i++) {
-        if(l1->ll_array[i] > l2->ll_array[i]) {
-            return 1;
-        }
-        else if (l1->ll_array[i] < l2->ll_array[i]){
-            return -1;
-        }
-    }
-    if(l1->ll_size > l2->ll_size) {
-        return 1;
-    } else if (l1->ll_size < l2->ll_size) {
-        return -1;
-    }
-
-    // unsigned long long comparison
-    m = min (l1->ull_size, l2->ull_size);
-    for(int i = 0; i < m; i++) {
-        if(l1->ull_array[i] > l2->ull_array[i]) {
-            return 1;
-        }
-        else if(l1->ull_array[i] < l2->ull_array[i]) {
-            return -1;
-        }
-
-    }
-    if(l1->ull_size > l2->ull_size) {
-        return 1;
-    } else if (l1->ull_size < l2->ull_size) {
-        return -1;
-    }
-
-    // double comparison
-    m = min (l1->dbl_size, l2->dbl_size);
-    for(int i = 0; i < m; i++) {
-        if(l1->dbl_array[i] > l2->dbl_array[i]) {
-            return 1;
-        } else if (l1->dbl_array[i] < l2->dbl_array[i]) {
-            return -1;
-        }
-    }
-    if(l1->dbl_size > l2->dbl_size) {
-        return 1;
-    } else if (l1->dbl_size < l2->dbl_size) {
-        return -1;
-    }
+    // lines are similar, they are kept in order of their numbers,
+    // so that the representative is the first line of its "block"
+    if (l1->number != l2->number)
+        return l1->number > l2->number ? 1 : -1;
 
-    // lines are similar
     return 0;
 }
 
@@ -292,10 +300,23 @@ int line_cmp_by_number (const void *a, const void *b) {
     return (*l1)->number - (*l2)->number;
 }
 
+// Compares representatives (pointers) by size of their "block" (descending),
+// then by their number
+int line_cmp_by_group_size (const void *a, const void *b) {
+    Line **l1 = (Line **) a;
+    Line **l2 = (Line **) b;
+
+    if ((*l1)->group_size != (*l2)->group_size)
+        return (*l2)->group_size - (*l1)->group_size;
+
+    return (*l1)->number - (*l2)->number;
+}
+
 // Having sorted (by data) array of lines, we look for representatives just by
 // comparing i, and i + 1 neighbours. If neighbours are similar, then they are in the same "block".
 // Otherwise, i + 1 element is a representative of a new "block"
-void find_representatives(Line *lines, Line ***representatives, int lines_size, int *rep_size, int *rep_capacity) {
+void find_representatives(Line *lines, Line ***representatives, int lines_size, int *rep_size, int *rep_capacity,
+                          bool store_members) {
 
     bool has_representative = false;
     int rep;
@@ -306,10 +327,15 @@ void find_representatives(Line *lines, Line ***representatives, int lines_size,
         // New representative found
         if (!has_representative) {
 
+            // The array is reserved with 'safe_reserve', so it grows the same way
             if(*rep_size == *rep_capacity) {
-                *representatives = (Line **) safe_realloc(*representatives, sizeof (Line*) * (*rep_capacity *= 2));
+                *representatives = (Line **) safe_reserve_resize(*representatives, sizeof (Line*) * *rep_capacity,
+                                                                 sizeof (Line*) * *rep_capacity * 2);
+                *rep_capacity *= 2;
             }
-            add_similar_line(&lines[i], lines[i].number);
+            if (store_members)
+                add_similar_line(&lines[i], lines[i].number);
+            lines[i].group_size = 1;
             (*representatives)[(*rep_size)++] = &lines[i];
 
             rep = i;
@@ -320,7 +346,9 @@ void find_representatives(Line *lines, Line ***representatives, int lines_size,
         // If these are similar lines, we update 'similar_lines' array of the representative.
         // Otherwise, we found another "block" with new representative.
         if (i < lines_size - 1 && compareLines(&lines[i], &lines[i + 1])) {
-            add_similar_line(&lines[rep], lines[i + 1].number);
+            if (store_members)
+                add_similar_line(&lines[rep], lines[i + 1].number);
+            lines[rep].group_size++;
         }
         else {
             has_representative = false;
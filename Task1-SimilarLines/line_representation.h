@@ -1,27 +1,58 @@
 #ifndef  LINE_REPRESENTATION_H
 #define LINE_REPRESENTATION_H
 
+// types of values, in the order in which they are compared
+// (the same numbers are returned by 'parse')
+enum value_type {
+    VALUE_STR,
+    VALUE_LL,
+    VALUE_ULL,
+    VALUE_DBL
+};
+
+// value that appears in line, together with its type (16 bytes)
+// strings are folded to lowercase, so that they can be compared with 'memcmp'
+struct typed_value {
+    int type;
+    // length of string value
+    int str_len;
+    union {
+        char *str;
+        long long ll;
+        unsigned long long ull;
+        double dbl;
+    };
+};
+
+typedef struct typed_value Value;
+
 // representation of line
 struct line_representation {
 
     int number;
 
     // dynamic array, holding the numbers of similar lines
-    int *similarLines;
+    // numbers are added in increasing order and stored as differences
+    // between consecutive numbers, encoded as varints (7 bits per byte)
+    unsigned char *similarLines;
+    // number of similar lines
     int size;
+    // number of used bytes and size of the array
+    int bytes;
     int capacity;
-
-    // dynamic arrays, holding the data that appears in line
-    char **str_array;
-    long long *ll_array;
-    unsigned long long *ull_array;
-    double *dbl_array;
-
-    // sizes of given arrays
+    // last added number, base for the next difference
+    int last_similar;
+
+    // number of lines in the "block" of the representative
+    // (counted even if numbers of similar lines aren't stored)
+    int group_size;
+
+    // dynamic array, holding the data that appears in line
+    // after sorting, values are ordered by type and then by value
+    Value *values;
+    int values_size;
+    // number of string values
     int str_size;
-    int ll_size;
-    int ull_size;
-    int dbl_size;
 
 };
 
@@ -36,46 +67,42 @@ void line_init(Line *line, int number);
 // Frees all the memory that was alloc'd in the structure
 void line_free(Line *line);
 
-// Adds 'char*' value to line that is passed as an argument
-void add_str (Line *current, char *strValue, int *str_capacity);
+// Adds value to line that is passed as an argument
+// String values are added with NULL pointer, they are set later by 'line_set_strings'
+void add_value (Line *current, Value value, int *values_capacity);
 
-// Adds 'long long' value to line that is passed as an argument
-void add_ll (Line *current, long long llValue, int *ll_capacity);
-
-// Adds 'unsigned long long' value to line that is passed as an argument
-void add_ull (Line *current, unsigned long long ullValue, int *ull_capacity);
-
-// Adds 'double' value to line that is passed as an argument
-void add_dbl (Line *current, double dblValue, int *dbl_capacity);
+// Sets pointers of string values (in the order they were added)
+// to consecutive '\0'-terminated strings held in 'strings'
+void line_set_strings (Line *current, char *strings);
 
 // Sorts all data that line contains
 void sort_data_in_line (Line *current);
 
 // adding the number of similar line to the line that is passed as an argument
+// numbers have to be added in increasing order
 void add_similar_line (Line *line, int number_of_similar);
 
+// Decodes at most 'out_size' next numbers of similar lines to 'out', returns how many were decoded.
+// 'offset' and 'last' hold the state of decoding between the calls, both should be set to 0 at the beginning.
+int decode_similar_lines (const Line *line, int *offset, int *last, int *out, int out_size);
+
 int min(int a, int b);
 
 // line comparator
-// compares lines by its data (used in qsort)
+// compares lines by its data, similar lines are compared by their number (used in qsort)
 int line_cmp_by_data (const void *a, const void *b);
 
 // looks for representative of each "block" after lines are sorted by data
-void find_representatives(Line *lines, Line ***representatives, int lines_size, int *rep_size, int *rep_capacity);
+// if 'store_members' is false, only sizes of the "blocks" are counted
+// 'representatives' has to be reserved with 'safe_reserve', it is resized the same way
+void find_representatives(Line *lines, Line ***representatives, int lines_size, int *rep_size, int *rep_capacity,
+                          bool store_members);
 
 // Compares lines (pointers) by their number
 int line_cmp_by_number (const void *a, const void *b);
 
-// case insensitive comparator for strings (used in qsort)
-int case_insensitive_cmp(const void *a, const void *b);
-
-// long long comparator (used in qsort)
-int ll_cmp (const void *a, const void *b);
-
-// double comparator (used in qsort)
-int dbl_cmp (const void *a, const void *b);
-
-// unsigned long long comparator (used in qsort)
-int ull_cmp (const void *a, const void *b);
+// Compares representatives (pointers) by size of their "block" (descending),
+// then by their number
+int line_cmp_by_group_size (const void *a, const void *b);
 
 #endif // LINE_REPRESENTATION_H
\ No newline at end of file
@@ -8,16 +8,25 @@
 #include <string.h>
 #include <strings.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <limits.h>
 #include <errno.h>
 #include <stdbool.h>
 #include "line_representation.h"
 #include "safe_allocs.h"
 #include "parser.h"
+#include "options.h"
+#include "reader.h"
+#include "tokenizer.h"
+#include "groups_file.h"
+#include "trace.h"
+
+// number of similar lines decoded at once while printing
+#define DECODE_CHUNK 256
 
 // Adds given word to the line structure
-void add_value_to_line (Line *current, char *word, int *str_capacity,
-                        int *ll_capacity, int *ull_capacity, int *dbl_capacity) {
+// Returns type of the word (see 'parse')
+int add_value_to_line (Line *current, char *word, int *values_capacity) {
 
     long long ll_value;
     unsigned long long ull_value;
@@ -25,131 +34,288 @@ void add_value_to_line (Line *current, char *word, int *str_capacity,
 
     errno = 0;
     // parses current word to corresponding data type
-    int which_type = parse(word, &ll_value, &ull_value, &dbl_value);
+    Value value = {.type = parse(word, &ll_value, &ull_value, &dbl_value)};
 
-    switch (which_type) {
-        // string
-        case 0:
-            add_str(current, word, str_capacity);
+    switch (value.type) {
+        // string, it's set after the whole line is read
+        case VALUE_STR:
+            value.str = NULL;
             break;
 
-        // long long
-        case 1:
-            add_ll(current, ll_value, ll_capacity);
+        case VALUE_LL:
+            value.ll = ll_value;
             break;
 
-        // unsigned long long
-        case 2:
-            add_ull(current, ull_value, ull_capacity);
+        case VALUE_ULL:
+            value.ull = ull_value;
             break;
 
-        // double
-        case 3:
-            add_dbl(current, dbl_value, dbl_capacity);
+        case VALUE_DBL:
+            value.dbl = dbl_value;
             break;
     }
+
+    add_value(current, value, values_capacity);
+
+    return value.type;
 }
 
-void output_and_freeing (char **buffers, Line *lines, Line **representatives, int lines_size, int rep_size) {
+// Prints numbers of similar lines, one "block" per line
+// Numbers are decoded in chunks of 'DECODE_CHUNK'
+void output_groups (Line **representatives, int rep_size) {
 
-    for(int i = 0; i < rep_size; i++) {
-        for (int j = 0; j < representatives[i]->size; j++) {
+    int numbers[DECODE_CHUNK];
 
-            if (j == representatives[i]->size - 1) {
-                if (fprintf(stdout, "%d", representatives[i]->similarLines[j] + 1) < 0)
-                    exit(EXIT_FAILURE);
-            }
-            else {
-                if (fprintf(stdout, "%d ", representatives[i]->similarLines[j] + 1) < 0)
-                    exit(EXIT_FAILURE);
+    for(int i = 0; i < rep_size; i++) {
+        int offset = 0, last = 0, printed = 0, decoded;
+
+        while ((decoded = decode_similar_lines(representatives[i], &offset, &last, numbers, DECODE_CHUNK)) > 0) {
+            for (int j = 0; j < decoded; j++, printed++) {
+
+                if (printed == representatives[i]->size - 1) {
+                    if (fprintf(stdout, "%d", numbers[j] + 1) < 0)
+                        exit(EXIT_FAILURE);
+                }
+                else {
+                    if (fprintf(stdout, "%d ", numbers[j] + 1) < 0)
+                        exit(EXIT_FAILURE);
+                }
             }
-
         }
         printf("\n");
     }
+}
+
+// Writes 'size' bytes to stdout, exits on failure
+void write_or_exit (const unsigned char *data, size_t size) {
+    if (fwrite(data, 1, size, stdout) != size)
+        exit(EXIT_FAILURE);
+}
+
+// Writes "blocks" in the binary format (see groups_file.h): header, sizes of all "blocks",
+// then numbers of their lines. Numbers are encoded in chunks of 'DECODE_CHUNK'.
+void output_binary (Line **representatives, int rep_size) {
+
+    unsigned char header[GROUPS_FILE_HEADER_SIZE];
+    unsigned char buffer[4 * DECODE_CHUNK];
+    int numbers[DECODE_CHUNK];
+
+    uint64_t members = 0;
+    for (int i = 0; i < rep_size; i++)
+        members += representatives[i]->size;
+
+    memcpy(header, GROUPS_FILE_MAGIC, 4);
+    groups_file_store32(header + 4, GROUPS_FILE_VERSION);
+    groups_file_store64(header + 8, rep_size);
+    groups_file_store64(header + 16, members);
+    write_or_exit(header, GROUPS_FILE_HEADER_SIZE);
+
+    for (int i = 0; i < rep_size; i += DECODE_CHUNK) {
+        int chunk = min(rep_size - i, DECODE_CHUNK);
+        for (int j = 0; j < chunk; j++)
+            groups_file_store32(buffer + 4 * j, representatives[i + j]->size);
+        write_or_exit(buffer, 4 * chunk);
+    }
+
+    for (int i = 0; i < rep_size; i++) {
+        int offset = 0, last = 0, decoded;
+
+        while ((decoded = decode_similar_lines(representatives[i], &offset, &last, numbers, DECODE_CHUNK)) > 0) {
+            for (int j = 0; j < decoded; j++)
+                groups_file_store32(buffer + 4 * j, numbers[j] + 1);
+            write_or_exit(buffer, 4 * decoded);
+        }
+    }
+}
+
+// Prints size and number of representative of 'top' biggest "blocks"
+// Representatives have to be sorted by the size of their "block"
+void output_top (Line **representatives, int rep_size, int top) {
+
+    for (int i = 0; i < min(rep_size, top); i++) {
+        if (fprintf(stdout, "%d %d\n", representatives[i]->group_size, representatives[i]->number + 1) < 0)
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Prints 'size count' pairs, where 'count' is the number of "blocks" with given size
+// Representatives have to be sorted by the size of their "block"
+void output_histogram (Line **representatives, int rep_size) {
+
+    // Iterating from the end, so that sizes are printed in increasing order
+    int count = 0;
+    for (int i = rep_size - 1; i >= 0; i--) {
+        count++;
+
+        if (i == 0 || representatives[i - 1]->group_size != representatives[i]->group_size) {
+            if (fprintf(stdout, "%d %d\n", representatives[i]->group_size, count) < 0)
+                exit(EXIT_FAILURE);
+            count = 0;
+        }
+    }
+}
+
+// Returns new capacity of an array holding 'size' lines (or buffers of lines).
+// If the size of input is known, the number of lines is predicted from the part
+// of input read so far (with small margin), otherwise the capacity is doubled.
+int next_capacity (Reader *reader, int size, int capacity) {
+
+    double predicted = 0;
+    if (reader->input_size != 0 && reader->consumed != 0)
+        predicted = (double) size * reader->input_size / reader->consumed * 1.05 + INITIAL_CAPACITY;
+
+    double result = predicted > capacity ? predicted : 2.0 * capacity;
+    if (result > INT_MAX)
+        result = INT_MAX;
+
+    return (int) result;
+}
+
+void output_and_freeing (char **buffers, Line *lines, Line **representatives, int buffers_size, int lines_size,
+                         int rep_size, int buffers_capacity, int lines_capacity, int rep_capacity, Options *options) {
+
+    switch (options->mode) {
+        case OUTPUT_GROUPS:
+            if (options->format == FORMAT_BINARY)
+                output_binary(representatives, rep_size);
+            else
+                output_groups(representatives, rep_size);
+            break;
+
+        case OUTPUT_COUNT:
+            if (fprintf(stdout, "%d\n", rep_size) < 0)
+                exit(EXIT_FAILURE);
+            break;
+
+        case OUTPUT_TOP:
+            output_top(representatives, rep_size, options->top);
+            break;
+
+        case OUTPUT_HISTOGRAM:
+            output_histogram(representatives, rep_size);
+            break;
+    }
 
     for(int i = 0; i < lines_size; i++) {
         line_free(&lines[i]);
-        free(buffers[i]);
     }
 
-    free(lines);
-    free(buffers);
-    free(representatives);
+    for(int i = 0; i < buffers_size; i++) {
+        safe_free(buffers[i]);
+    }
+
+    safe_reserve_free(lines, sizeof (Line) * lines_capacity);
+    safe_reserve_free(buffers, sizeof (char*) * buffers_capacity);
+    safe_reserve_free(representatives, sizeof (Line*) * rep_capacity);
 }
 
-int main() {
+int main(int argc, char **argv) {
 
-    // Holds the content of non-empty lines.
-    // Needed to free all the memory that 'getline' allocates.
-    char **buffers = (char**) safe_malloc(INITIAL_CAPACITY * sizeof (char*));
-    int buffers_size = 0, buffers_capacity = INITIAL_CAPACITY;
+    Options options;
+    parse_options(&options, argc, argv);
 
-    // Holds the lines
-    Line *lines = (Line*) safe_malloc(INITIAL_CAPACITY * sizeof (Line));
-    int lines_size = 0, lines_capacity = INITIAL_CAPACITY;
+    // Phases are traced if TRACE_FILE is set (see trace.h).
+    trace_thread_name("main");
+    trace_begin("parse lines");
+
+    // Input is read in a separate thread, while we parse lines here.
+    Reader reader;
+    reader_init(&reader, fileno(stdin));
+
+    // If input is a regular file, arrays are reserved for the estimated number of lines at once.
+    // Too big estimate costs only address space, since untouched pages aren't allocated.
+    size_t estimate = reader_estimate_lines(&reader);
+    int initial_capacity = INITIAL_CAPACITY;
+    if (estimate > INITIAL_CAPACITY)
+        initial_capacity = estimate * 1.05 < INT_MAX ? (int) (estimate * 1.05) : INT_MAX;
+
+    // Holds the string values of lines, each line has its own buffer.
+    // Needed to free all the memory that 'tokenizer_take_strings' allocates.
+    char **buffers = (char**) safe_reserve(initial_capacity * sizeof (char*));
+    int buffers_size = 0, buffers_capacity = initial_capacity;
 
-    size_t buf_size = 4;
-    int characters;
-    char *buffer =  (char*) safe_malloc(buf_size * sizeof(char));
+    // Holds the lines
+    Line *lines = (Line*) safe_reserve(initial_capacity * sizeof (Line));
+    int lines_size = 0, lines_capacity = initial_capacity;
 
-    // variables used in 'strtok' function
-    char *delimiter = " \t\r\v\f\n";
+    // Lines are split into tokens straight from the chunks of input.
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, &reader, options.utf8);
     char *word;
 
     int count = 0;
-    while ((characters = getline(&buffer, &buf_size, stdin)) != -1 && errno != ENOMEM) {
+    while (tokenizer_next_line(&tokenizer)) {
 
-        errno = 0;
+        Line current;
+        line_init(&current, count);
 
-        int len = (int) strlen(buffer);
-        bool is_error_or_comment = check_illegal_characters_or_comment (buffer, len, characters, count);
+        // Variable that holds capacity of values array in current line.
+        // NOTE: we don't need to hold this value in 'Line' struct
+        int values_capacity = 0;
+
+        // Only the projected fields are parsed and stored,
+        // the rest of the line is only checked after the last of them.
+        int field = 0, range = 0;
+        enum token_status status;
+        while ((status = tokenizer_next_token(&tokenizer, &word)) == TOKEN_READ) {
+            if (field_projected(&options, field, &range)) {
+                // string values have to outlive the token
+                if (add_value_to_line(&current, word, &values_capacity) == VALUE_STR)
+                    tokenizer_keep_token(&tokenizer);
+            }
+            else if (projection_exhausted(&options, range)) {
+                status = tokenizer_skip_line(&tokenizer);
+                break;
+            }
+            field++;
+        }
 
-        word = strtok(buffer, delimiter);
+        if (status == TOKEN_ERROR)
+            print_error(count);
 
         // Checks if line is empty or should be ignored
         // If any of these is true, we just skip this line
-        // If there is any illegal character, 'is_error_or_comment' function prints it to stderr
-        if(word == NULL || is_error_or_comment){
+        if (status != TOKEN_END_OF_LINE || field == 0) {
+            line_free(&current);
             count++;
             continue;
         }
 
-        Line current;
-        line_init(&current, count);
-
-        // Variables that hold capacity of arrays that are in current line.
-        // NOTE: we don't need to hold these values in 'Line' struct
-        int str_capacity = 0, ll_capacity = 0, ull_capacity = 0, dbl_capacity = 0;
+        // saves string values of current line, they are pointed by its values
+        if (current.str_size != 0) {
+            char *strings = tokenizer_take_strings(&tokenizer);
+            line_set_strings(&current, strings);
 
-        while(word != NULL) {
-            add_value_to_line(&current, word, &str_capacity, &ll_capacity, &ull_capacity, &dbl_capacity);
-
-            word = strtok(NULL, delimiter);
+            if (buffers_size == buffers_capacity) {
+                int new_capacity = next_capacity(&reader, buffers_size, buffers_capacity);
+                buffers = (char**) safe_reserve_resize(buffers, sizeof (char*) * buffers_capacity,
+                                                       sizeof (char*) * new_capacity);
+                buffers_capacity = new_capacity;
+            }
+            buffers[buffers_size++] = strings;
         }
 
         sort_data_in_line (&current);
 
-        // saves content of current line as a string
-        if (buffers_size == buffers_capacity) {
-            buffers = (char**) safe_realloc(buffers, sizeof (char*) * (buffers_capacity *= 2));
-        }
-        buffers[buffers_size++] = buffer;
-        buffer = (char*) safe_malloc(buf_size * sizeof(char));
-
         // saves current line
         if (lines_size == lines_capacity) {
-            lines = (Line*) safe_realloc(lines, sizeof (Line) * (lines_capacity *= 2));
+            int new_capacity = next_capacity(&reader, lines_size, lines_capacity);
+            lines = (Line*) safe_reserve_resize(lines, sizeof (Line) * lines_capacity,
+                                                sizeof (Line) * new_capacity);
+            lines_capacity = new_capacity;
         }
         lines[lines_size++] = current;
 
         count++;
     }
 
-    if (errno == ENOMEM)
-        exit(EXIT_FAILURE);
+    tokenizer_free(&tokenizer);
+    reader_free(&reader);
 
-    free(buffer);
+    trace_end("parse lines");
+    trace_counter("lines", lines_size);
+    trace_memory();
+    trace_begin("sort lines");
 
     // Sorts all lines by data.
     // After that, we have our lines divided in "blocks",
@@ -159,16 +325,40 @@ int main() {
     // There is no guarantee that representatives will appear in the right order.
     qsort(lines, lines_size, sizeof (Line), line_cmp_by_data);
 
+    trace_end("sort lines");
+    trace_begin("find representatives");
+
     // We create an array that will hold a pointer to every representative of each "block"
-    Line **representatives = (Line **) safe_malloc(INITIAL_CAPACITY * sizeof (Line*));
-    int rep_size = 0, rep_capacity = INITIAL_CAPACITY;
+    // There are at most as many "blocks" as lines, so it never has to grow.
+    int rep_size = 0, rep_capacity = lines_size > INITIAL_CAPACITY ? lines_size : INITIAL_CAPACITY;
+    Line **representatives = (Line **) safe_reserve(rep_capacity * sizeof (Line*));
+
+    // Numbers of similar lines are needed only if we print the whole "blocks",
+    // otherwise counting their sizes is enough.
+    find_representatives(lines, &representatives, lines_size, &rep_size, &rep_capacity,
+                         options.mode == OUTPUT_GROUPS);
+
+    trace_end("find representatives");
+    trace_counter("groups", rep_size);
+    trace_memory();
+    trace_begin("sort representatives");
+
+    if (options.mode == OUTPUT_GROUPS) {
+        // sorting the representatives of every "block" by line number
+        qsort(representatives, rep_size, sizeof (Line *), line_cmp_by_number);
+    }
+    else if (options.mode == OUTPUT_TOP || options.mode == OUTPUT_HISTOGRAM) {
+        qsort(representatives, rep_size, sizeof (Line *), line_cmp_by_group_size);
+    }
 
-    find_representatives(lines, &representatives, lines_size, &rep_size, &rep_capacity);
+    trace_end("sort representatives");
+    trace_begin("output");
 
-    // sorting the representatives of every "block" by line number
-    qsort(representatives, rep_size, sizeof (Line *), line_cmp_by_number);
+    output_and_freeing(buffers, lines, representatives, buffers_size, lines_size, rep_size,
+                       buffers_capacity, lines_capacity, rep_capacity, &options);
 
-    output_and_freeing(buffers, lines, representatives, lines_size, rep_size);
+    trace_end("output");
+    options_free(&options);
 
     return 0;
 }
\ No newline at end of file
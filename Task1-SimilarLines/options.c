@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
+#include "options.h"
+#include "safe_allocs.h"
+
+static void print_usage_and_exit(char *program) {
+    fprintf(stderr, "Usage: %s [--fields=LIST] [--utf8] [--format=FMT] [--count | --top K | --histogram]\n", program);
+    fprintf(stderr, "  --fields=LIST  take into account only the given fields of every line,\n"
+                    "                 LIST is a comma separated list of field numbers (counted from 1)\n"
+                    "                 or ranges 'N-M', 'N-' (e.g. --fields=1,3-5,8-)\n"
+                    "  --utf8         accept UTF-8 input, strings are compared with simple case folding\n"
+                    "  --format=FMT   'text' (default) or 'binary', binary groups are described\n"
+                    "                 in groups_file.h and can't be combined with other output modes\n"
+                    "  --count        print only the number of groups of similar lines\n"
+                    "  --top K        print size and first line of the K biggest groups\n"
+                    "  --histogram    print number of groups of every size ('size count' pairs)\n");
+    exit(EXIT_FAILURE);
+}
+
+// Parses positive number (field number or argument of an option),
+// 'end' is set to the first character after it
+static bool parse_positive_number(char *str, char **end, int *number) {
+
+    if (*str < '0' || *str > '9')
+        return false;
+
+    errno = 0;
+    long value = strtol(str, end, 10);
+
+    if (errno == ERANGE || value < 1 || value > INT_MAX)
+        return false;
+
+    *number = (int) value;
+    return true;
+}
+
+static void add_range(Options *options, int first, int last) {
+
+    if (options->ranges_capacity == 0) {
+        options->ranges = (Range *) safe_malloc(INITIAL_CAPACITY * sizeof (Range));
+        options->ranges_capacity = INITIAL_CAPACITY;
+    }
+    else if (options->ranges_size == options->ranges_capacity) {
+        options->ranges = (Range *) safe_realloc(options->ranges, sizeof (Range) * (options->ranges_capacity *= 2));
+    }
+    options->ranges[options->ranges_size++] = (Range) {.first = first, .last = last};
+}
+
+// range comparator (used in qsort)
+static int range_cmp (const void *a, const void *b) {
+
+    Range *r1 = (Range *) a;
+    Range *r2 = (Range *) b;
+
+    if (r1->first != r2->first)
+        return r1->first > r2->first ? 1 : -1;
+
+    return 0;
+}
+
+// Sorts ranges and merges the overlapping ones,
+// so that every field is checked with at most one range
+static void normalize_ranges(Options *options) {
+
+    qsort(options->ranges, options->ranges_size, sizeof (Range), range_cmp);
+
+    int size = 0;
+    for (int i = 0; i < options->ranges_size; i++) {
+        Range cur = options->ranges[i];
+
+        if (size > 0 && (options->ranges[size - 1].last == -1 || options->ranges[size - 1].last >= cur.first - 1)) {
+            Range *prev = &options->ranges[size - 1];
+            if (prev->last != -1 && (cur.last == -1 || cur.last > prev->last))
+                prev->last = cur.last;
+        }
+        else {
+            options->ranges[size++] = cur;
+        }
+    }
+    options->ranges_size = size;
+}
+
+// Parses list of fields, e.g. "1,3-5,8-"
+static bool parse_fields(Options *options, char *list) {
+
+    char *ptr = list;
+
+    while (true) {
+        int first, last;
+
+        if (!parse_positive_number(ptr, &ptr, &first))
+            return false;
+
+        last = first;
+        if (*ptr == '-') {
+            ptr++;
+            if (*ptr == ',' || *ptr == '\0')
+                last = 0;
+            else if (!parse_positive_number(ptr, &ptr, &last) || last < first)
+                return false;
+        }
+
+        // fields are counted from 0 inside the program
+        add_range(options, first - 1, last - 1);
+
+        if (*ptr == '\0')
+            break;
+        if (*ptr != ',')
+            return false;
+        ptr++;
+    }
+
+    normalize_ranges(options);
+    return true;
+}
+
+void parse_options(Options *options, int argc, char **argv) {
+
+    options->ranges_size = 0;
+    options->ranges_capacity = 0;
+    options->mode = OUTPUT_GROUPS;
+    options->top = 0;
+    options->format = FORMAT_TEXT;
+    options->utf8 = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--fields=", 9) == 0) {
+            if (!parse_fields(options, argv[i] + 9))
+                print_usage_and_exit(argv[0]);
+        }
+        else if (strcmp(argv[i], "--utf8") == 0) {
+            options->utf8 = true;
+        }
+        else if (strcmp(argv[i], "--format=text") == 0) {
+            options->format = FORMAT_TEXT;
+        }
+        else if (strcmp(argv[i], "--format=binary") == 0) {
+            options->format = FORMAT_BINARY;
+        }
+        else if (options->mode != OUTPUT_GROUPS) {
+            // output modes are mutually exclusive
+            print_usage_and_exit(argv[0]);
+        }
+        else if (strcmp(argv[i], "--count") == 0) {
+            options->mode = OUTPUT_COUNT;
+        }
+        else if (strcmp(argv[i], "--histogram") == 0) {
+            options->mode = OUTPUT_HISTOGRAM;
+        }
+        else if (strcmp(argv[i], "--top") == 0) {
+            char *end;
+            if (i + 1 == argc || !parse_positive_number(argv[i + 1], &end, &options->top) || *end != '\0')
+                print_usage_and_exit(argv[0]);
+            options->mode = OUTPUT_TOP;
+            i++;
+        }
+        else {
+            print_usage_and_exit(argv[0]);
+        }
+    }
+
+    if (options->format == FORMAT_BINARY && options->mode != OUTPUT_GROUPS)
+        print_usage_and_exit(argv[0]);
+}
+
+void options_free(Options *options) {
+    if (options->ranges_capacity != 0)
+        safe_free(options->ranges);
+}
+
+bool field_projected(const Options *options, int field, int *range) {
+
+    if (options->ranges_size == 0)
+        return true;
+
+    while (*range < options->ranges_size && options->ranges[*range].last != -1
+           && options->ranges[*range].last < field) {
+        (*range)++;
+    }
+
+    return *range < options->ranges_size && options->ranges[*range].first <= field;
+}
+
+bool projection_exhausted(const Options *options, int range) {
+    return options->ranges_size != 0 && range == options->ranges_size;
+}
@@ -0,0 +1,69 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+
+// closed range of field (token) indices, counted from 0
+// 'last' equal to -1 means that range reaches the end of line
+struct field_range {
+    int first;
+    int last;
+};
+
+typedef struct field_range Range;
+
+// what the program writes to stdout
+enum output_mode {
+    // numbers of similar lines, one group per line
+    OUTPUT_GROUPS,
+    // number of groups
+    OUTPUT_COUNT,
+    // sizes and representatives of the biggest groups
+    OUTPUT_TOP,
+    // number of groups of every size
+    OUTPUT_HISTOGRAM
+};
+
+// how the output is written
+enum output_format {
+    // decimal numbers
+    FORMAT_TEXT,
+    // arrays of little-endian numbers (see groups_file.h), only for OUTPUT_GROUPS
+    FORMAT_BINARY
+};
+
+// command line options of the program
+struct program_options {
+
+    // dynamic array, holding the projected fields (sorted and disjoint ranges)
+    // if it's empty, every field of the line is taken into account
+    Range *ranges;
+    int ranges_size;
+    int ranges_capacity;
+
+    enum output_mode mode;
+    // number of groups printed in OUTPUT_TOP mode
+    int top;
+    enum output_format format;
+
+    // input is UTF-8 text instead of ASCII
+    bool utf8;
+};
+
+typedef struct program_options Options;
+
+// Parses command line arguments, prints usage and exits on invalid ones
+void parse_options(Options *options, int argc, char **argv);
+
+// Frees all the memory that was alloc'd in the structure
+void options_free(Options *options);
+
+// Checks if field with given index is projected.
+// Fields have to be checked in increasing order, 'range' holds the position of
+// the current range between the calls and should be set to 0 at the beginning of every line.
+bool field_projected(const Options *options, int field, int *range);
+
+// Checks if there are no more projected fields after the current range
+bool projection_exhausted(const Options *options, int range);
+
+#endif // OPTIONS_H
@@ -133,30 +133,11 @@ void print_error (int number_of_line) {
         exit(EXIT_FAILURE);
 }
 
-// Checks if line has any illegal characters
-// Casts every 'char' in buffer to 'int' that represents its ascii value
-bool check_illegal_characters_or_comment (char *buffer, int len, int characters, int number_of_line) {
+// Checks if character may not appear in a line
+// Casts 'char' to 'int' that represents its ascii value
+bool check_illegal_character (char c) {
 
-    // line is a comment so we ignore it
-    if (buffer[0] == '#')
-        return true;
-
-    // Checks if there appears '\0' character in buffer
-    // 'characters' is the value returned by 'getline' function.
-    // Length of string is less then 'characters' -> there appears '\0'.
-    if (len < characters) {
-        print_error(number_of_line);
-        return true;
-    }
-
-    for (int i = 0; i < len; i++) {
-        int cast = (int) buffer[i];
+    int cast = (int) c;
 
-        if ((cast < 32 || (int) cast > 126) && (cast < 9 || cast > 13)) {
-            print_error(number_of_line);
-            return true;
-        }
-    }
-
-    return false;
-}
\ No newline at end of file
+    return (cast < 32 || cast > 126) && (cast < 9 || cast > 13);
+}
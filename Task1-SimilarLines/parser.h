@@ -18,7 +18,7 @@ int parse (char *word, long long *ll_value, unsigned long long *ull_value, doubl
 
 void print_error(int number_of_line);
 
-// Checks if line has any illegal characters or if line is a comment
-bool check_illegal_characters_or_comment (char *buffer, int len, int characters, int numberOfLine);
+// Checks if character may not appear in a line
+bool check_illegal_character (char c);
 
 #endif // PPARSER_H
\ No newline at end of file
@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "reader.h"
+#include "safe_allocs.h"
+#include "trace.h"
+
+// Waits for the other side of the ring.
+// At first only yields the processor, then sleeps, so that a thread
+// waiting for a long time (e.g. reader with the full ring) doesn't burn CPU.
+static void backoff(int *spins) {
+
+    if (*spins < READER_SPINS) {
+        (*spins)++;
+        sched_yield();
+    }
+    else {
+        struct timespec pause = {.tv_sec = 0, .tv_nsec = READER_SLEEP_NS};
+        nanosleep(&pause, NULL);
+    }
+}
+
+// Fills the chunk with data, until it's full or there is nothing more to read.
+// Read errors are treated as the end of input, same as in 'getline'.
+static size_t fill_chunk(int fd, Chunk *chunk) {
+
+    size_t size = 0;
+    while (size < READER_CHUNK_SIZE) {
+        ssize_t got = read(fd, chunk->data + size, READER_CHUNK_SIZE - size);
+
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+
+        size += (size_t) got;
+    }
+    return size;
+}
+
+// Fills next free chunk of the ring, returns false if the input has ended.
+// The chunk is published only after its data is written ('release' store of head).
+static bool produce_chunk(Reader *reader) {
+
+    size_t head = atomic_load_explicit(&reader->head, memory_order_relaxed);
+
+    // waits for the consumer to free a chunk
+    int spins = 0;
+    while (head - atomic_load_explicit(&reader->tail, memory_order_acquire) == READER_SLOTS)
+        backoff(&spins);
+
+    Chunk *chunk = &reader->chunks[head % READER_SLOTS];
+    trace_begin("read chunk");
+    chunk->size = fill_chunk(reader->fd, chunk);
+    trace_end("read chunk");
+
+    if (chunk->size == 0) {
+        atomic_store_explicit(&reader->finished, true, memory_order_release);
+        return false;
+    }
+
+    atomic_store_explicit(&reader->head, head + 1, memory_order_release);
+    return true;
+}
+
+static void* reader_thread(void *arg) {
+
+    Reader *reader = (Reader *) arg;
+    trace_thread_name("reader");
+    while (produce_chunk(reader));
+
+    return NULL;
+}
+
+void reader_init(Reader *reader, int fd) {
+
+    reader->fd = fd;
+    reader->position = 0;
+    reader->consumed = 0;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        reader->input_size = (size_t) st.st_size;
+    else
+        reader->input_size = 0;
+    atomic_init(&reader->head, 0);
+    atomic_init(&reader->tail, 0);
+    atomic_init(&reader->finished, false);
+
+    for (int i = 0; i < READER_SLOTS; i++) {
+        reader->chunks[i].data = (char *) safe_aligned_alloc(READER_ALIGNMENT, READER_CHUNK_SIZE);
+        reader->chunks[i].size = 0;
+    }
+
+    // With a single processor reading and parsing can't overlap,
+    // the thread would only add context switches.
+    reader->threaded = sysconf(_SC_NPROCESSORS_ONLN) > 1
+                       && pthread_create(&reader->thread, NULL, reader_thread, reader) == 0;
+}
+
+void reader_free(Reader *reader) {
+
+    // the thread may be waiting for a free chunk if parsing was stopped early
+    if (reader->threaded) {
+        size_t head = atomic_load_explicit(&reader->head, memory_order_acquire);
+        atomic_store_explicit(&reader->tail, head, memory_order_release);
+        while (!atomic_load_explicit(&reader->finished, memory_order_acquire)) {
+            head = atomic_load_explicit(&reader->head, memory_order_acquire);
+            atomic_store_explicit(&reader->tail, head, memory_order_release);
+            sched_yield();
+        }
+        pthread_join(reader->thread, NULL);
+    }
+
+    for (int i = 0; i < READER_SLOTS; i++)
+        safe_free(reader->chunks[i].data);
+}
+
+// Returns the chunk that is currently parsed, waiting for the producer if needed.
+// Returns NULL at the end of input.
+static Chunk* current_chunk(Reader *reader) {
+
+    size_t tail = atomic_load_explicit(&reader->tail, memory_order_relaxed);
+    int spins = 0;
+
+    while (atomic_load_explicit(&reader->head, memory_order_acquire) == tail) {
+        if (atomic_load_explicit(&reader->finished, memory_order_acquire)) {
+            // the last chunk might have been published just before finishing
+            if (atomic_load_explicit(&reader->head, memory_order_acquire) == tail)
+                return NULL;
+        }
+        else if (!reader->threaded) {
+            produce_chunk(reader);
+        }
+        else {
+            backoff(&spins);
+        }
+    }
+
+    return &reader->chunks[tail % READER_SLOTS];
+}
+
+// Gives the chunk back to the producer
+static void release_chunk(Reader *reader) {
+
+    size_t tail = atomic_load_explicit(&reader->tail, memory_order_relaxed);
+    atomic_store_explicit(&reader->tail, tail + 1, memory_order_release);
+    reader->position = 0;
+}
+
+// Average line length is taken from the first chunk
+// (the whole chunk is one line, if there's no '\n' in it).
+size_t reader_estimate_lines(Reader *reader) {
+
+    if (reader->input_size == 0)
+        return 0;
+
+    Chunk *chunk = current_chunk(reader);
+    if (chunk == NULL)
+        return 0;
+
+    size_t lines = 1;
+    const char *ptr = chunk->data, *end = chunk->data + chunk->size;
+    while ((ptr = (const char *) memchr(ptr, '\n', (size_t) (end - ptr))) != NULL) {
+        lines++;
+        ptr++;
+    }
+
+    return (size_t) ((double) lines * reader->input_size / chunk->size);
+}
+
+const char* reader_peek(Reader *reader, size_t *size) {
+
+    Chunk *chunk = current_chunk(reader);
+    if (chunk == NULL)
+        return NULL;
+
+    *size = chunk->size - reader->position;
+    return chunk->data + reader->position;
+}
+
+void reader_advance(Reader *reader, size_t size) {
+
+    Chunk *chunk = &reader->chunks[atomic_load_explicit(&reader->tail, memory_order_relaxed) % READER_SLOTS];
+
+    reader->position += size;
+    reader->consumed += size;
+    if (reader->position == chunk->size)
+        release_chunk(reader);
+}
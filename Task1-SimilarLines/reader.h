@@ -0,0 +1,79 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// size of a single chunk of input read at once
+#define READER_CHUNK_SIZE (1 << 20)
+
+// number of chunks in the ring, the reader can be that many chunks ahead of the parser
+#define READER_SLOTS 4
+
+// number of yields before a waiting thread starts to sleep, and length of a single sleep
+#define READER_SPINS 64
+#define READER_SLEEP_NS 50000
+
+// alignment of chunk buffers
+#define READER_ALIGNMENT 4096
+
+// chunk of input data
+struct reader_chunk {
+    char *data;
+    size_t size;
+};
+
+typedef struct reader_chunk Chunk;
+
+// Reads input in a separate thread, so that reading and parsing overlap.
+// The reading thread (producer) fills chunks and the parser (consumer) takes them
+// in the same order, through a single-producer/single-consumer ring.
+struct input_reader {
+
+    int fd;
+    pthread_t thread;
+    // false if the thread couldn't be started (or there is only one processor),
+    // chunks are then read by the consumer itself
+    bool threaded;
+
+    Chunk chunks[READER_SLOTS];
+
+    // number of chunks filled by the producer, written only by the producer
+    _Atomic size_t head;
+    // number of chunks consumed by the parser, written only by the consumer
+    _Atomic size_t tail;
+    // set by the producer after the last chunk was filled
+    _Atomic bool finished;
+
+    // position in the current chunk (used only by the consumer)
+    size_t position;
+
+    // size of the input if it's a regular file, 0 otherwise
+    size_t input_size;
+    // number of bytes passed by 'reader_advance' so far
+    size_t consumed;
+};
+
+typedef struct input_reader Reader;
+
+// Starts reading from given file descriptor
+void reader_init(Reader *reader, int fd);
+
+// Waits for the reading thread and frees all the memory that was alloc'd in the structure
+void reader_free(Reader *reader);
+
+// Estimates number of lines in the input, basing on its size and the first chunk.
+// Returns 0 if the input isn't a regular file.
+size_t reader_estimate_lines(Reader *reader);
+
+// Returns pointer to the unread part of the current chunk and its size (always positive),
+// waiting for the reading thread if needed. Returns NULL at the end of input.
+// Data is valid until the chunk is passed with 'reader_advance'.
+const char* reader_peek(Reader *reader, size_t *size);
+
+// Marks next 'size' bytes (at most the size returned by 'reader_peek') as read
+void reader_advance(Reader *reader, size_t size);
+
+#endif // READER_H
@@ -1,11 +1,27 @@
 #ifndef SAFE_ALLOCS_H
 #define SAFE_ALLOCS_H
 
+#include <stddef.h>
+#include "alloc.h"
+
 // initial capacity for malloc/realloc functions
 #define INITIAL_CAPACITY 4
 
-// Functions that safely allocate heap memory
-void* safe_malloc (size_t size);
-void* safe_realloc (void *ptr, size_t size);
+// Safe allocation of heap memory, through the allocation layer shared with Task2.
+// These are macros, so that the layer knows their call sites.
+// Memory allocated by them has to be freed with 'safe_free'.
+#define safe_malloc(size) alloc_malloc((size), ALLOC_SITE)
+#define safe_realloc(ptr, size) alloc_realloc((ptr), (size), ALLOC_SITE)
+#define safe_free(ptr) alloc_free(ptr)
+
+// Allocates aligned memory, it has to be freed with 'safe_free' too
+#define safe_aligned_alloc(alignment, size) alloc_aligned((alignment), (size), ALLOC_SITE)
+
+// Reserve address space for big arrays.
+// Pages are allocated on first touch, so reserving more than needed is cheap,
+// and resizing moves pages instead of copying the data.
+#define safe_reserve(size) alloc_reserve((size), ALLOC_SITE)
+#define safe_reserve_resize(ptr, old_size, new_size) alloc_reserve_resize((ptr), (old_size), (new_size), ALLOC_SITE)
+#define safe_reserve_free(ptr, size) alloc_reserve_free((ptr), (size))
 
 #endif // SAFE_ALLOCS_H
\ No newline at end of file
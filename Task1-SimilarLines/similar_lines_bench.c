@@ -0,0 +1,170 @@
+// Benchmarks of the hot loops of similar_lines, built with 'make bench'
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "bench.h"
+#include "line_representation.h"
+#include "safe_allocs.h"
+#include "parser.h"
+#include "utf8.h"
+
+// number of generated lines, and number of distinct contents among them
+#define BENCH_LINES 200000
+#define BENCH_KEYS (BENCH_LINES / 4)
+#define BENCH_MAX_VALUES 8
+// number of comparisons of random pairs of lines
+#define BENCH_PAIRS 2000000
+
+static const char *words[] = {
+    "alpha", "Beta", "gamma", "DELTA", "epsilon", "zeta", "eta", "theta",
+    "0x1F", "-42", "3.25", "1e10", "18446744073709551615", "nan", "inf", "007"
+};
+
+// xorshift generator, so that results don't depend on the libc
+static uint64_t next_random (uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Generates words of line with given key, in random order.
+// Lines with the same key are similar.
+static int generate_words (uint64_t key, uint64_t *order, char **line_words) {
+
+    uint64_t state = key * 0x9E3779B97F4A7C15u + 1;
+    int count = 1 + next_random(&state) % BENCH_MAX_VALUES;
+
+    for (int i = 0; i < count; i++)
+        line_words[i] = (char*) words[next_random(&state) % (sizeof (words) / sizeof (words[0]))];
+
+    for (int i = count - 1; i > 0; i--) {
+        int j = next_random(order) % (i + 1);
+        char *tmp = line_words[i];
+        line_words[i] = line_words[j];
+        line_words[j] = tmp;
+    }
+
+    return count;
+}
+
+// Builds a line the same way as main does: parses the words, folds strings, sorts values
+static void build_line (Line *line, int number, char **line_words, int count, char **strings) {
+
+    int values_capacity = 0;
+    size_t strings_size = 0;
+    *strings = (char*) safe_malloc(BENCH_MAX_VALUES * 32);
+
+    line_init(line, number);
+
+    for (int i = 0; i < count; i++) {
+        char word[32];
+        strcpy(word, line_words[i]);
+
+        long long ll_value;
+        unsigned long long ull_value;
+        double dbl_value;
+        Value value = {.type = parse(word, &ll_value, &ull_value, &dbl_value)};
+
+        if (value.type == VALUE_STR) {
+            size_t size = strlen(word) + 1;
+            fold_ascii(*strings + strings_size, word, size);
+            strings_size += size;
+            value.str = NULL;
+        }
+        else if (value.type == VALUE_LL) {
+            value.ll = ll_value;
+        }
+        else if (value.type == VALUE_ULL) {
+            value.ull = ull_value;
+        }
+        else {
+            value.dbl = dbl_value;
+        }
+
+        add_value(line, value, &values_capacity);
+    }
+
+    line_set_strings(line, *strings);
+}
+
+int main (void) {
+
+    Line *lines = (Line*) safe_malloc(BENCH_LINES * sizeof (Line));
+    char **strings = (char**) safe_malloc(BENCH_LINES * sizeof (char*));
+    char **all_words = (char**) safe_malloc((size_t) BENCH_LINES * BENCH_MAX_VALUES * sizeof (char*));
+    int *counts = (int*) safe_malloc(BENCH_LINES * sizeof (int));
+    uint64_t order = 88172645463325252u;
+
+    for (int i = 0; i < BENCH_LINES; i++)
+        counts[i] = generate_words(next_random(&order) % BENCH_KEYS, &order, all_words + i * BENCH_MAX_VALUES);
+
+    bench_report_header(stdout);
+
+    // parsing every word of every line
+    Bench bench;
+    bench_init(&bench, "parse");
+    bench_start(&bench);
+    uint64_t types = 0, parsed = 0;
+    for (int i = 0; i < BENCH_LINES; i++) {
+        for (int j = 0; j < counts[i]; j++, parsed++) {
+            char word[32];
+            long long ll_value;
+            unsigned long long ull_value;
+            double dbl_value;
+            strcpy(word, all_words[i * BENCH_MAX_VALUES + j]);
+            types += parse(word, &ll_value, &ull_value, &dbl_value);
+        }
+    }
+    bench_stop(&bench, parsed);
+    bench_use(types);
+    bench_report(&bench, stdout);
+    bench_free(&bench);
+
+    for (int i = 0; i < BENCH_LINES; i++)
+        build_line(&lines[i], i, all_words + i * BENCH_MAX_VALUES, counts[i], &strings[i]);
+
+    bench_init(&bench, "sort_data_in_line");
+    bench_start(&bench);
+    for (int i = 0; i < BENCH_LINES; i++)
+        sort_data_in_line(&lines[i]);
+    bench_stop(&bench, BENCH_LINES);
+    bench_report(&bench, stdout);
+    bench_free(&bench);
+
+    // comparisons of random pairs, most of them are decided by the first values
+    bench_init(&bench, "line_cmp_by_data");
+    uint64_t pair_state = 0x2545F4914F6CDD1Du;
+    int64_t sum = 0;
+    bench_start(&bench);
+    for (int i = 0; i < BENCH_PAIRS; i++) {
+        uint64_t random = next_random(&pair_state);
+        sum += line_cmp_by_data(&lines[random % BENCH_LINES], &lines[(random >> 32) % BENCH_LINES]);
+    }
+    bench_stop(&bench, BENCH_PAIRS);
+    bench_use((uint64_t) sum);
+    bench_report(&bench, stdout);
+    bench_free(&bench);
+
+    bench_init(&bench, "qsort(line_cmp_by_data)");
+    bench_start(&bench);
+    qsort(lines, BENCH_LINES, sizeof (Line), line_cmp_by_data);
+    bench_stop(&bench, BENCH_LINES);
+    bench_report(&bench, stdout);
+    bench_free(&bench);
+
+    for (int i = 0; i < BENCH_LINES; i++) {
+        line_free(&lines[i]);
+        safe_free(strings[i]);
+    }
+
+    safe_free(lines);
+    safe_free(strings);
+    safe_free(all_words);
+    safe_free(counts);
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "tokenizer.h"
+#include "parser.h"
+#include "safe_allocs.h"
+#include "utf8.h"
+
+// classes of characters
+enum char_class {
+    CHAR_TOKEN,
+    CHAR_DELIMITER,
+    CHAR_ILLEGAL
+};
+
+// class of every character, filled in 'tokenizer_init'
+static unsigned char char_classes[256];
+
+// characters that separate tokens
+static const char *delimiters = " \t\r\v\f\n";
+
+static enum char_class class_of(char c) {
+    return (enum char_class) char_classes[(unsigned char) c];
+}
+
+void tokenizer_init(Tokenizer *tokenizer, Reader *reader, bool utf8) {
+
+    for (int i = 0; i < 256; i++) {
+        if (i != 0 && strchr(delimiters, i) != NULL)
+            char_classes[i] = CHAR_DELIMITER;
+        // bytes of multibyte sequences, validated with the whole token
+        else if (utf8 && i >= 0x80)
+            char_classes[i] = CHAR_TOKEN;
+        else if (check_illegal_character((char) i))
+            char_classes[i] = CHAR_ILLEGAL;
+        else
+            char_classes[i] = CHAR_TOKEN;
+    }
+
+    tokenizer->reader = reader;
+    tokenizer->utf8 = utf8;
+    tokenizer->comment = false;
+
+    tokenizer->token_capacity = INITIAL_CAPACITY;
+    tokenizer->token = (char *) safe_malloc(tokenizer->token_capacity * sizeof (char));
+    tokenizer->token_size = 0;
+
+    tokenizer->strings = NULL;
+    tokenizer->strings_size = 0;
+    tokenizer->strings_capacity = 0;
+}
+
+void tokenizer_free(Tokenizer *tokenizer) {
+    safe_free(tokenizer->token);
+    safe_free(tokenizer->strings);
+}
+
+// Passes the rest of the line, including '\n'
+static void skip_to_end_of_line(Tokenizer *tokenizer) {
+
+    const char *data;
+    size_t size;
+
+    while ((data = reader_peek(tokenizer->reader, &size)) != NULL) {
+        const char *new_line = (const char *) memchr(data, '\n', size);
+
+        if (new_line != NULL) {
+            reader_advance(tokenizer->reader, (size_t) (new_line - data) + 1);
+            return;
+        }
+        reader_advance(tokenizer->reader, size);
+    }
+}
+
+bool tokenizer_next_line(Tokenizer *tokenizer) {
+
+    size_t size;
+    const char *data = reader_peek(tokenizer->reader, &size);
+
+    if (data == NULL)
+        return false;
+
+    // line is a comment, so we ignore it
+    tokenizer->comment = data[0] == '#';
+    // strings that weren't taken from the previous line are discarded
+    tokenizer->strings_size = 0;
+
+    return true;
+}
+
+// Adds 'size' characters to the current token
+static void append_to_token(Tokenizer *tokenizer, const char *data, size_t size) {
+
+    if (tokenizer->token_size + size + 1 > tokenizer->token_capacity) {
+        while (tokenizer->token_size + size + 1 > tokenizer->token_capacity)
+            tokenizer->token_capacity *= 2;
+        tokenizer->token = (char *) safe_realloc(tokenizer->token, tokenizer->token_capacity * sizeof (char));
+    }
+
+    memcpy(tokenizer->token + tokenizer->token_size, data, size);
+    tokenizer->token_size += size;
+}
+
+// A token may be split between chunks, then it is continued in the next call
+enum token_status tokenizer_next_token(Tokenizer *tokenizer, char **token) {
+
+    if (tokenizer->comment) {
+        skip_to_end_of_line(tokenizer);
+        return TOKEN_COMMENT;
+    }
+
+    const char *data;
+    size_t size;
+    tokenizer->token_size = 0;
+
+    while ((data = reader_peek(tokenizer->reader, &size)) != NULL) {
+        size_t i = 0;
+
+        // delimiters before the token
+        if (tokenizer->token_size == 0) {
+            while (i < size && class_of(data[i]) == CHAR_DELIMITER) {
+                if (data[i] == '\n') {
+                    reader_advance(tokenizer->reader, i + 1);
+                    return TOKEN_END_OF_LINE;
+                }
+                i++;
+            }
+        }
+
+        size_t j = i;
+        while (j < size && class_of(data[j]) == CHAR_TOKEN)
+            j++;
+
+        append_to_token(tokenizer, data + i, j - i);
+
+        if (j < size) {
+            reader_advance(tokenizer->reader, j);
+
+            if (class_of(data[j]) == CHAR_ILLEGAL) {
+                skip_to_end_of_line(tokenizer);
+                return TOKEN_ERROR;
+            }
+            // token ended with a delimiter, which is left for the next call
+            if (tokenizer->token_size != 0)
+                break;
+        }
+        else {
+            reader_advance(tokenizer->reader, size);
+        }
+    }
+
+    // end of input ends the last line
+    if (tokenizer->token_size == 0)
+        return TOKEN_END_OF_LINE;
+
+    // Multibyte sequences can't contain delimiters, so they are never split between tokens.
+    if (tokenizer->utf8 && !utf8_validate(tokenizer->token, tokenizer->token_size)) {
+        skip_to_end_of_line(tokenizer);
+        return TOKEN_ERROR;
+    }
+
+    tokenizer->token[tokenizer->token_size] = '\0';
+    *token = tokenizer->token;
+    return TOKEN_READ;
+}
+
+enum token_status tokenizer_skip_line(Tokenizer *tokenizer) {
+
+    const char *data;
+    size_t size;
+
+    // multibyte sequences may be split between chunks, so they are checked token by token
+    if (tokenizer->utf8) {
+        enum token_status status;
+        char *token;
+        while ((status = tokenizer_next_token(tokenizer, &token)) == TOKEN_READ);
+        return status;
+    }
+
+    while ((data = reader_peek(tokenizer->reader, &size)) != NULL) {
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] == '\n') {
+                reader_advance(tokenizer->reader, i + 1);
+                return TOKEN_END_OF_LINE;
+            }
+            if (class_of(data[i]) == CHAR_ILLEGAL) {
+                reader_advance(tokenizer->reader, i);
+                skip_to_end_of_line(tokenizer);
+                return TOKEN_ERROR;
+            }
+        }
+        reader_advance(tokenizer->reader, size);
+    }
+
+    return TOKEN_END_OF_LINE;
+}
+
+// String values are folded to lowercase, so that they can be compared byte by byte.
+// Folded UTF-8 text is never longer than the original one.
+void tokenizer_keep_token(Tokenizer *tokenizer) {
+
+    size_t size = tokenizer->token_size + 1;
+
+    if (tokenizer->strings_capacity == 0) {
+        tokenizer->strings_capacity = INITIAL_CAPACITY;
+        tokenizer->strings = (char *) safe_malloc(tokenizer->strings_capacity * sizeof (char));
+    }
+    if (tokenizer->strings_size + size > tokenizer->strings_capacity) {
+        while (tokenizer->strings_size + size > tokenizer->strings_capacity)
+            tokenizer->strings_capacity *= 2;
+        tokenizer->strings = (char *) safe_realloc(tokenizer->strings, tokenizer->strings_capacity * sizeof (char));
+    }
+
+    if (tokenizer->utf8) {
+        tokenizer->strings_size += utf8_fold(tokenizer->strings + tokenizer->strings_size,
+                                             tokenizer->token, tokenizer->token_size);
+        tokenizer->strings[tokenizer->strings_size++] = '\0';
+    }
+    else {
+        fold_ascii(tokenizer->strings + tokenizer->strings_size, tokenizer->token, size);
+        tokenizer->strings_size += size;
+    }
+}
+
+char* tokenizer_take_strings(Tokenizer *tokenizer) {
+
+    // the memory is given to the caller, so it's shrunk to the size of the strings
+    char *strings = (char *) safe_realloc(tokenizer->strings, tokenizer->strings_size * sizeof (char));
+
+    tokenizer->strings = NULL;
+    tokenizer->strings_size = 0;
+    tokenizer->strings_capacity = 0;
+
+    return strings;
+}
@@ -0,0 +1,69 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "reader.h"
+
+// result of reading a token
+enum token_status {
+    // next token of the line was read
+    TOKEN_READ,
+    // line has ended
+    TOKEN_END_OF_LINE,
+    // line has ended, it's a comment
+    TOKEN_COMMENT,
+    // line has ended, it has an illegal character
+    TOKEN_ERROR
+};
+
+// Splits input into lines and tokens, straight from chunks of the reader.
+// Lines are never buffered as a whole, only the current token and
+// the string values of the current line are kept in memory.
+struct line_tokenizer {
+
+    Reader *reader;
+
+    // true if tokens may contain UTF-8 multibyte sequences
+    bool utf8;
+
+    // true if the current line is a comment (starts with '#')
+    bool comment;
+
+    // current token, terminated by '\0'
+    char *token;
+    size_t token_size;
+    size_t token_capacity;
+
+    // string values kept from the current line, one after another, each terminated by '\0'
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+};
+
+typedef struct line_tokenizer Tokenizer;
+
+// If 'utf8' is true, bytes above 127 are allowed in tokens, as long as they form valid UTF-8
+void tokenizer_init(Tokenizer *tokenizer, Reader *reader, bool utf8);
+
+// Frees all the memory that was alloc'd in the structure
+void tokenizer_free(Tokenizer *tokenizer);
+
+// Starts the next line, returns false at the end of input
+bool tokenizer_next_line(Tokenizer *tokenizer);
+
+// Reads next token of the line to '*token', it's valid until the next call.
+// Tokens that were read before the line turned out to be an error should be discarded.
+enum token_status tokenizer_next_token(Tokenizer *tokenizer, char **token);
+
+// Checks the rest of the line without reading its tokens
+enum token_status tokenizer_skip_line(Tokenizer *tokenizer);
+
+// Keeps the current token as a string value of the line
+void tokenizer_keep_token(Tokenizer *tokenizer);
+
+// Returns string values kept in the current line, one after another, each terminated by '\0'.
+// The memory has to be freed by the caller, at least one value has to be kept.
+char* tokenizer_take_strings(Tokenizer *tokenizer);
+
+#endif // TOKENIZER_H
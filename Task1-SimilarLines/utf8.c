@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "utf8.h"
+
+static const unsigned long long ones = 0x0101010101010101ULL;
+static const unsigned long long high_bits = 0x8080808080808080ULL;
+
+// Checks if 8 bytes starting at 'text' are ASCII characters
+static inline bool ascii_word(const char *text) {
+
+    unsigned long long word;
+    memcpy(&word, text, sizeof (word));
+
+    return (word & high_bits) == 0;
+}
+
+// Folds 8 characters at a time.
+// For every byte of a word, the highest bit of 'upper' is set iff the byte is in 'A'..'Z'
+// (additions don't overflow into the next byte, as the highest bits are cleared first).
+void fold_ascii (char *dst, const char *src, size_t size) {
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long word;
+        memcpy(&word, src + i, sizeof (word));
+
+        unsigned long long low = word & ~high_bits;
+        unsigned long long at_least_a = low + ones * (0x80 - 'A');
+        unsigned long long above_z = low + ones * (0x7F - 'Z');
+        unsigned long long upper = at_least_a & ~above_z & ~word & high_bits;
+
+        word |= upper >> 2;
+        memcpy(dst + i, &word, sizeof (word));
+    }
+
+    for (; i < size; i++) {
+        char c = src[i];
+        dst[i] = (c >= 'A' && c <= 'Z') ? (char) (c - 'A' + 'a') : c;
+    }
+}
+
+// Decodes a multibyte sequence starting at 'text' to '*code_point'.
+// Returns its length, or 0 if it's not valid.
+static size_t decode(const unsigned char *text, size_t size, uint32_t *code_point) {
+
+    size_t length;
+    uint32_t cp, minimum;
+
+    if ((text[0] & 0xE0) == 0xC0) {
+        length = 2;
+        cp = text[0] & 0x1F;
+        minimum = 0x80;
+    }
+    else if ((text[0] & 0xF0) == 0xE0) {
+        length = 3;
+        cp = text[0] & 0x0F;
+        minimum = 0x800;
+    }
+    else if ((text[0] & 0xF8) == 0xF0) {
+        length = 4;
+        cp = text[0] & 0x07;
+        minimum = 0x10000;
+    }
+    else {
+        return 0;
+    }
+
+    if (size < length)
+        return 0;
+
+    for (size_t i = 1; i < length; i++) {
+        if ((text[i] & 0xC0) != 0x80)
+            return 0;
+        cp = (cp << 6) | (text[i] & 0x3F);
+    }
+
+    if (cp < minimum || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        return 0;
+
+    *code_point = cp;
+    return length;
+}
+
+// Encodes code point (at least U+0080), returns length of the sequence
+static size_t encode(unsigned char *dst, uint32_t cp) {
+
+    if (cp < 0x800) {
+        dst[0] = (unsigned char) (0xC0 | (cp >> 6));
+        dst[1] = (unsigned char) (0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        dst[0] = (unsigned char) (0xE0 | (cp >> 12));
+        dst[1] = (unsigned char) (0x80 | ((cp >> 6) & 0x3F));
+        dst[2] = (unsigned char) (0x80 | (cp & 0x3F));
+        return 3;
+    }
+    dst[0] = (unsigned char) (0xF0 | (cp >> 18));
+    dst[1] = (unsigned char) (0x80 | ((cp >> 12) & 0x3F));
+    dst[2] = (unsigned char) (0x80 | ((cp >> 6) & 0x3F));
+    dst[3] = (unsigned char) (0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Checks if code point is in range and has the given parity
+static bool in_range(uint32_t cp, uint32_t first, uint32_t last, uint32_t parity) {
+    return cp >= first && cp <= last && (cp & 1) == parity;
+}
+
+// Simple case folding of a single non-ASCII code point
+// (a subset of Unicode CaseFolding.txt, statuses C and S)
+static uint32_t fold_code_point(uint32_t cp) {
+
+    // Latin-1 Supplement
+    if ((cp >= 0x00C0 && cp <= 0x00DE && cp != 0x00D7))
+        return cp + 0x20;
+    if (cp == 0x00B5)
+        return 0x03BC;
+
+    // Latin Extended-A, pairs of uppercase and lowercase letters
+    if (in_range(cp, 0x0100, 0x012F, 0) || in_range(cp, 0x0132, 0x0137, 0) || in_range(cp, 0x0139, 0x0148, 1)
+        || in_range(cp, 0x014A, 0x0177, 0) || in_range(cp, 0x0179, 0x017E, 1))
+        return cp + 1;
+    if (cp == 0x0178)
+        return 0x00FF;
+    if (cp == 0x017F)
+        return 0x0073;
+
+    // Greek
+    if (cp == 0x0386)
+        return 0x03AC;
+    if (cp >= 0x0388 && cp <= 0x038A)
+        return cp + 0x25;
+    if (cp == 0x038C)
+        return 0x03CC;
+    if (cp >= 0x038E && cp <= 0x038F)
+        return cp + 0x3F;
+    if ((cp >= 0x0391 && cp <= 0x03A1) || (cp >= 0x03A3 && cp <= 0x03AB))
+        return cp + 0x20;
+    if (cp == 0x03C2)
+        return 0x03C3;
+    if (in_range(cp, 0x03D8, 0x03EF, 0))
+        return cp + 1;
+
+    // Cyrillic
+    if (cp >= 0x0400 && cp <= 0x040F)
+        return cp + 0x50;
+    if (cp >= 0x0410 && cp <= 0x042F)
+        return cp + 0x20;
+    if (in_range(cp, 0x0460, 0x0481, 0) || in_range(cp, 0x048A, 0x04BF, 0)
+        || in_range(cp, 0x04C1, 0x04CE, 1) || in_range(cp, 0x04D0, 0x052F, 0))
+        return cp + 1;
+    if (cp == 0x04C0)
+        return 0x04CF;
+
+    // Armenian
+    if (cp >= 0x0531 && cp <= 0x0556)
+        return cp + 0x30;
+
+    // Latin Extended Additional
+    if (in_range(cp, 0x1E00, 0x1E95, 0) || in_range(cp, 0x1EA0, 0x1EFF, 0))
+        return cp + 1;
+    if (cp == 0x1E9E)
+        return 0x00DF;
+
+    // Letterlike symbols
+    if (cp == 0x2126)
+        return 0x03C9;
+    if (cp == 0x212A)
+        return 0x006B;
+    if (cp == 0x212B)
+        return 0x00E5;
+
+    // Fullwidth Latin letters
+    if (cp >= 0xFF21 && cp <= 0xFF3A)
+        return cp + 0x20;
+
+    return cp;
+}
+
+// Blocks of 8 ASCII characters are skipped at once,
+// only the blocks that contain multibyte sequences are decoded.
+bool utf8_validate (const char *text, size_t size) {
+
+    const unsigned char *bytes = (const unsigned char *) text;
+    size_t i = 0;
+
+    while (i < size) {
+        if (i + 8 <= size && ascii_word(text + i)) {
+            i += 8;
+            continue;
+        }
+
+        if (bytes[i] < 0x80) {
+            i++;
+            continue;
+        }
+
+        uint32_t cp;
+        size_t length = decode(bytes + i, size - i, &cp);
+        if (length == 0)
+            return false;
+        i += length;
+    }
+
+    return true;
+}
+
+// ASCII blocks are folded as in 'fold_ascii'
+size_t utf8_fold (char *dst, const char *src, size_t size) {
+
+    const unsigned char *bytes = (const unsigned char *) src;
+    size_t i = 0, written = 0;
+
+    while (i < size) {
+        if (i + 8 <= size && ascii_word(src + i)) {
+            fold_ascii(dst + written, src + i, 8);
+            i += 8;
+            written += 8;
+            continue;
+        }
+
+        if (bytes[i] < 0x80) {
+            fold_ascii(dst + written, src + i, 1);
+            i++;
+            written++;
+            continue;
+        }
+
+        uint32_t cp;
+        size_t length = decode(bytes + i, size - i, &cp);
+
+        uint32_t folded = fold_code_point(cp);
+        if (folded < 0x80)
+            dst[written++] = (char) folded;
+        else
+            written += encode((unsigned char *) dst + written, folded);
+
+        i += length;
+    }
+
+    return written;
+}
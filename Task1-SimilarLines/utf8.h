@@ -0,0 +1,20 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Copies 'size' characters folding ASCII uppercase letters to lowercase,
+// other bytes are copied unchanged
+void fold_ascii (char *dst, const char *src, size_t size);
+
+// Checks if 'size' bytes are a valid UTF-8 text
+// (no overlong encodings, surrogates or code points above U+10FFFF)
+bool utf8_validate (const char *text, size_t size);
+
+// Copies valid UTF-8 text applying simple case folding (Latin, Greek, Cyrillic,
+// Armenian and fullwidth Latin letters). Returns the size of the folded text,
+// which is never bigger than 'size'.
+size_t utf8_fold (char *dst, const char *src, size_t size);
+
+#endif // UTF8_H
@@ -17,6 +17,13 @@
 #include <limits.h>
 #include <errno.h>
 #include "parser.h"
+#include "safe_alloc.h"
+#include "trace.h"
+
+/**
+ * Co ile wierszy zapisywane jest zużycie pamięci w śladzie wykonania.
+ */
+#define TRACE_MEMORY_PERIOD 1024
 
 /**
  * Funkcja obsługująca standardowe wejście.
@@ -24,24 +31,34 @@
 void HandleInput() {
     Stack stack;
     StackInit(&stack);
-    size_t buf_size = 4, line = 0;
+    // Bufor alokuje i powiększa getline, więc nie pochodzi z safeMalloc.
+    size_t buf_size = 0, line = 0;
     ssize_t characters;
-    char *buffer = (char*) safeMalloc(sizeof(char) * INITIAL_CAPACITY);
+    char *buffer = NULL;
 
     while ((characters = getline(&buffer, &buf_size, stdin)) != -1 && errno != ENOMEM) {
         size_t len = strlen(buffer);
         HandleLine(buffer, line, &stack, len, (size_t) characters);
         line++;
+        if (line % TRACE_MEMORY_PERIOD == 0)
+            trace_memory();
     }
     free(buffer);
     StackDestroy(&stack);
+    PolyFreeCaches();
+    trace_memory();
 }
 
 /**
  * Główna funkcja programu.
+ * Zmienna środowiskowa POLY_HASH_CONSING włącza hash-consing wielomianów.
  * @return kod zakończenia programu
  */
 int main() {
+    const char *hash_consing = getenv("POLY_HASH_CONSING");
+    if (hash_consing != NULL && hash_consing[0] != '\0' && strcmp(hash_consing, "0") != 0)
+        PolyHashConsing(true);
+
     HandleInput();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,396 @@
+/** @file
+ * Implementacja interfejsu dense.h.
+
+  @author Mikołaj Uzarski
+  @date 2021
+*/
+
+#include <stdbool.h>
+#include <string.h>
+#include "dense.h"
+#include "poly.h"
+#include "safe_alloc.h"
+
+/**
+ * Liczba liczb pierwszych, modulo które liczone są transformaty.
+ */
+#define NTT_PRIMES 3
+
+/** Typ iloczynów liczb 64-bitowych. */
+typedef unsigned __int128 dense_wide_t;
+
+/**
+ * Liczba pierwsza postaci @f$ c 2^k + 1 @f$ ze stałymi arytmetyki Montgomery'ego
+ * (liczby w postaci Montgomery'ego to @f$ x 2^{64} \bmod p @f$).
+ */
+typedef struct NttPrime {
+    /** Liczba pierwsza, mniejsza od @f$ 2^{62} @f$. */
+    uint64_t p;
+    /** Pierwiastek pierwotny modulo p. */
+    uint64_t root;
+    /** @f$ -p^{-1} \bmod 2^{64} @f$. */
+    uint64_t p_inv;
+    /** @f$ 2^{128} \bmod p @f$. */
+    uint64_t r2;
+} NttPrime;
+
+/**
+ * Liczby pierwsze transformat i ich pierwiastki pierwotne.
+ * Ich iloczyn przekracza @f$ 2^{183} @f$, a współczynnik iloczynu wielomianów
+ * o @f$ n @f$ współczynnikach jest mniejszy od @f$ n 2^{128} @f$.
+ */
+static const uint64_t ntt_primes[NTT_PRIMES][2] = {
+    {4179340454199820289u, 3}, // 29 * 2^57 + 1
+    {2485986994308513793u, 5}, // 69 * 2^55 + 1
+    {1945555039024054273u, 5}, // 27 * 2^56 + 1
+};
+
+void DenseAdd(dense_coeff_t *a, const dense_coeff_t *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        a[i] += b[i];
+    }
+}
+
+void DenseSub(dense_coeff_t *a, const dense_coeff_t *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        a[i] -= b[i];
+    }
+}
+
+/**
+ * Mnoży wielomiany @p a i @p b algorytmem szkolnym.
+ * @param[in] a : tablica @p n współczynników
+ * @param[in] n : liczba współczynników @p a
+ * @param[in] b : tablica @p m współczynników
+ * @param[in] m : liczba współczynników @p b
+ * @param[out] res : tablica na @f$ n+m-1 @f$ współczynników iloczynu
+ */
+static void DenseMulBasic(const dense_coeff_t *a, size_t n, const dense_coeff_t *b, size_t m, dense_coeff_t *res) {
+    memset(res, 0, sizeof(dense_coeff_t) * (n + m - 1));
+
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] == 0) {
+            continue;
+        }
+        for (size_t j = 0; j < m; j++) {
+            res[i + j] += a[i] * b[j];
+        }
+    }
+}
+
+/**
+ * Mnoży wielomiany @p a i @p b o tej samej liczbie współczynników algorytmem Karatsuby.
+ * Dla @f$ a = a_0 + x^h a_1 @f$, @f$ b = b_0 + x^h b_1 @f$ liczy
+ * @f$ z_0 = a_0b_0 @f$, @f$ z_2 = a_1b_1 @f$ oraz @f$ (a_0 + a_1)(b_0 + b_1) - z_0 - z_2 @f$.
+ * @param[in] a : tablica @p n współczynników
+ * @param[in] b : tablica @p n współczynników
+ * @param[in] n : liczba współczynników
+ * @param[out] res : tablica na @f$ 2n-1 @f$ współczynników iloczynu
+ * @param[in] scratch : pamięć robocza na co najmniej @f$ 4n + 256 @f$ współczynników
+ */
+static void DenseKaratsuba(const dense_coeff_t *a, const dense_coeff_t *b, size_t n,
+                           dense_coeff_t *res, dense_coeff_t *scratch) {
+    if (n < DENSE_KARATSUBA_CUTOFF) {
+        DenseMulBasic(a, n, b, n, res);
+        return;
+    }
+
+    // Młodsza połowa ma h współczynników, starsza k >= h.
+    size_t h = n / 2, k = n - h;
+
+    // Iloczyny połówek trafiają od razu na swoje miejsca w wyniku.
+    DenseKaratsuba(a, b, h, res, scratch);
+    res[2 * h - 1] = 0;
+    DenseKaratsuba(a + h, b + h, k, res + 2 * h, scratch);
+
+    dense_coeff_t *sum_a = scratch;
+    dense_coeff_t *sum_b = scratch + k;
+    dense_coeff_t *middle = scratch + 2 * k;
+
+    memcpy(sum_a, a + h, sizeof(dense_coeff_t) * k);
+    memcpy(sum_b, b + h, sizeof(dense_coeff_t) * k);
+    DenseAdd(sum_a, a, h);
+    DenseAdd(sum_b, b, h);
+
+    DenseKaratsuba(sum_a, sum_b, k, middle, scratch + 4 * k);
+    DenseSub(middle, res, 2 * h - 1);
+    DenseSub(middle, res + 2 * h, 2 * k - 1);
+    DenseAdd(res + h, middle, 2 * k - 1);
+}
+
+void DenseMulKaratsuba(const dense_coeff_t *a, size_t n, const dense_coeff_t *b, size_t m, dense_coeff_t *res) {
+    if (n < m) {
+        const dense_coeff_t *tmp = a;
+        a = b;
+        b = tmp;
+        size_t tmp_size = n;
+        n = m;
+        m = tmp_size;
+    }
+
+    if (m < DENSE_KARATSUBA_CUTOFF) {
+        DenseMulBasic(a, n, b, m, res);
+        return;
+    }
+
+    // Dłuższy wielomian dzielimy na kawałki długości krótszego
+    // i każdy z nich mnożymy algorytmem Karatsuby.
+    dense_coeff_t *scratch = (dense_coeff_t*) safeMalloc(sizeof(dense_coeff_t) * (4 * m + 256));
+    dense_coeff_t *product = (dense_coeff_t*) safeMalloc(sizeof(dense_coeff_t) * (2 * m - 1));
+    dense_coeff_t *block = (dense_coeff_t*) safeMalloc(sizeof(dense_coeff_t) * m);
+
+    memset(res, 0, sizeof(dense_coeff_t) * (n + m - 1));
+
+    for (size_t offset = 0; offset < n; offset += m) {
+        size_t len = n - offset < m ? n - offset : m;
+        const dense_coeff_t *part = a + offset;
+
+        // Ostatni kawałek uzupełniamy zerami.
+        if (len < m) {
+            memcpy(block, part, sizeof(dense_coeff_t) * len);
+            memset(block + len, 0, sizeof(dense_coeff_t) * (m - len));
+            part = block;
+        }
+
+        DenseKaratsuba(part, b, m, product, scratch);
+        DenseAdd(res + offset, product, len + m - 1);
+    }
+
+    safeFree(block);
+    safeFree(product);
+    safeFree(scratch);
+}
+
+/**
+ * Liczy stałe arytmetyki Montgomery'ego dla liczby pierwszej.
+ * @param[out] m : liczba pierwsza ze stałymi
+ * @param[in] p : liczba pierwsza
+ * @param[in] root : pierwiastek pierwotny modulo p
+ */
+static void NttPrimeInit(NttPrime *m, uint64_t p, uint64_t root) {
+    m->p = p;
+    m->root = root;
+
+    // Metoda Newtona, każdy krok podwaja liczbę poprawnych bitów odwrotności.
+    uint64_t inv = p;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - p * inv;
+    }
+    m->p_inv = -inv;
+
+    uint64_t r = (uint64_t) (((dense_wide_t) 1 << 64) % p);
+    m->r2 = (uint64_t) ((dense_wide_t) r * r % p);
+}
+
+/**
+ * Sprowadza do przedziału @f$ [0, p) @f$ liczbę z przedziału @f$ [-p, p) @f$ (bez skoków,
+ * bo wynik porównania w transformacie jest losowy).
+ * @param[in] a : liczba z przedziału @f$ [-p, p) @f$, zapisana modulo @f$ 2^{64} @f$
+ * @param[in] p : liczba pierwsza mniejsza od @f$ 2^{62} @f$
+ * @return @f$ a \bmod p @f$
+ */
+static inline uint64_t ModNormalize(uint64_t a, uint64_t p) {
+    return a + (p & -(a >> 63));
+}
+
+/**
+ * Redukcja Montgomery'ego.
+ * @param[in] t : liczba mniejsza od @f$ p 2^{64} @f$ (wtedy @f$ (t + kp) 2^{-64} < 2p @f$)
+ * @param[in] m : liczba pierwsza
+ * @return @f$ t 2^{-64} \bmod p @f$
+ */
+static inline uint64_t MontReduce(dense_wide_t t, const NttPrime *m) {
+    uint64_t k = (uint64_t) t * m->p_inv;
+    uint64_t r = (uint64_t) ((t + (dense_wide_t) k * m->p) >> 64);
+    return ModNormalize(r - m->p, m->p);
+}
+
+/**
+ * Mnoży liczby modulo p (w postaci Montgomery'ego, lub jedną zwykłą - wtedy wynik jest zwykły).
+ * @param[in] a : liczba, @f$ ab < 2^{64} p @f$
+ * @param[in] b : liczba mniejsza od p
+ * @param[in] m : liczba pierwsza
+ * @return @f$ ab 2^{-64} \bmod p @f$
+ */
+static inline uint64_t MontMul(uint64_t a, uint64_t b, const NttPrime *m) {
+    return MontReduce((dense_wide_t) a * b, m);
+}
+
+/**
+ * Zamienia liczbę na postać Montgomery'ego. Liczba może być dowolna,
+ * bo @f$ a 2^{128} \bmod p < 2^{64} p @f$ mieści się w zakresie redukcji.
+ * @param[in] a : liczba
+ * @param[in] m : liczba pierwsza
+ * @return @f$ a 2^{64} \bmod p @f$
+ */
+static inline uint64_t MontFrom(uint64_t a, const NttPrime *m) {
+    return MontMul(a, m->r2, m);
+}
+
+/**
+ * Podnosi liczbę w postaci Montgomery'ego do potęgi.
+ * @param[in] a : liczba w postaci Montgomery'ego
+ * @param[in] exp : wykładnik
+ * @param[in] m : liczba pierwsza
+ * @return @f$ a^{exp} @f$ w postaci Montgomery'ego
+ */
+static uint64_t MontPow(uint64_t a, uint64_t exp, const NttPrime *m) {
+    uint64_t result = MontFrom(1, m);
+
+    while (exp > 0) {
+        if (exp % 2 == 1) {
+            result = MontMul(result, a, m);
+        }
+        a = MontMul(a, a, m);
+        exp /= 2;
+    }
+
+    return result;
+}
+
+/**
+ * Liczy potęgi pierwiastka z jedności potrzebne w jednym etapie transformaty.
+ * @param[out] twiddles : tablica na @p half liczb
+ * @param[in] half : liczba potęg
+ * @param[in] root : pierwiastek pierwotny modulo p w postaci Montgomery'ego
+ * @param[in] m : liczba pierwsza
+ */
+static void NttTwiddles(uint64_t *twiddles, size_t half, uint64_t root, const NttPrime *m) {
+    uint64_t step = MontPow(root, (m->p - 1) / (2 * half), m);
+
+    twiddles[0] = MontFrom(1, m);
+    for (size_t j = 1; j < half; j++) {
+        twiddles[j] = MontMul(twiddles[j - 1], step, m);
+    }
+}
+
+/**
+ * Transformata teorioliczbowa w miejscu. Prosta (algorytm Gentlemana-Sande'a) zostawia
+ * wynik w kolejności odwróconych bitów indeksów, a odwrotna (algorytm Cooleya-Tukeya)
+ * przyjmuje dane w tej kolejności, więc mnożenie po współrzędnych nie wymaga permutacji.
+ * @param[in,out] a : tablica @p n liczb w postaci Montgomery'ego
+ * @param[in] n : rozmiar tablicy, potęga dwójki
+ * @param[in] twiddles : pamięć robocza na @f$ n/2 @f$ liczb
+ * @param[in] prime : liczba pierwsza
+ * @param[in] invert : czy liczyć transformatę odwrotną
+ */
+static void Ntt(uint64_t *a, size_t n, uint64_t *twiddles, const NttPrime *prime, bool invert) {
+    // Lokalna kopia, zapisy do a nie mogą jej zmienić, więc stałe zostają w rejestrach.
+    const NttPrime local = *prime;
+    const NttPrime *m = &local;
+
+    uint64_t root = MontFrom(m->root, m);
+
+    if (!invert) {
+        for (size_t half = n / 2; half >= 1; half /= 2) {
+            NttTwiddles(twiddles, half, root, m);
+
+            for (size_t i = 0; i < n; i += 2 * half) {
+                for (size_t j = 0; j < half; j++) {
+                    uint64_t u = a[i + j];
+                    uint64_t v = a[i + j + half];
+                    a[i + j] = ModNormalize(u + v - m->p, m->p);
+                    a[i + j + half] = MontMul(ModNormalize(u - v, m->p), twiddles[j], m);
+                }
+            }
+        }
+        return;
+    }
+
+    root = MontPow(root, m->p - 2, m);
+
+    for (size_t half = 1; half < n; half *= 2) {
+        NttTwiddles(twiddles, half, root, m);
+
+        for (size_t i = 0; i < n; i += 2 * half) {
+            for (size_t j = 0; j < half; j++) {
+                uint64_t u = a[i + j];
+                uint64_t v = MontMul(a[i + j + half], twiddles[j], m);
+                a[i + j] = ModNormalize(u + v - m->p, m->p);
+                a[i + j + half] = ModNormalize(u - v, m->p);
+            }
+        }
+    }
+
+    uint64_t n_inv = MontPow(MontFrom(n, m), m->p - 2, m);
+    for (size_t i = 0; i < n; i++) {
+        a[i] = MontMul(a[i], n_inv, m);
+    }
+}
+
+void DenseMulNtt(const dense_coeff_t *a, size_t n, const dense_coeff_t *b, size_t m, dense_coeff_t *res) {
+    size_t len = n + m - 1;
+    size_t size = 1;
+    while (size < len) {
+        size <<= 1;
+    }
+
+    NttPrime primes[NTT_PRIMES];
+    for (int k = 0; k < NTT_PRIMES; k++) {
+        NttPrimeInit(&primes[k], ntt_primes[k][0], ntt_primes[k][1]);
+    }
+
+    uint64_t *fa = (uint64_t*) safeMalloc(sizeof(uint64_t) * size);
+    uint64_t *fb = (uint64_t*) safeMalloc(sizeof(uint64_t) * size);
+    uint64_t *twiddles = (uint64_t*) safeMalloc(sizeof(uint64_t) * (size / 2 + 1));
+    uint64_t *residues = (uint64_t*) safeMalloc(sizeof(uint64_t) * NTT_PRIMES * len);
+
+    for (int k = 0; k < NTT_PRIMES; k++) {
+        const NttPrime *prime = &primes[k];
+
+        for (size_t i = 0; i < size; i++) {
+            fa[i] = i < n ? MontFrom(a[i], prime) : 0;
+            fb[i] = i < m ? MontFrom(b[i], prime) : 0;
+        }
+
+        Ntt(fa, size, twiddles, prime, false);
+        Ntt(fb, size, twiddles, prime, false);
+        for (size_t i = 0; i < size; i++) {
+            fa[i] = MontMul(fa[i], fb[i], prime);
+        }
+        Ntt(fa, size, twiddles, prime, true);
+
+        // Wychodzimy z postaci Montgomery'ego.
+        for (size_t i = 0; i < len; i++) {
+            residues[k * len + i] = MontReduce(fa[i], prime);
+        }
+    }
+
+    const NttPrime *m1 = &primes[0], *m2 = &primes[1], *m3 = &primes[2];
+    // Odwrotności w postaci Montgomery'ego, MontMul ze zwykłą liczbą daje zwykły wynik.
+    uint64_t p1_inv_mod_p2 = MontPow(MontFrom(m1->p, m2), m2->p - 2, m2);
+    uint64_t p1_mod_p3 = MontFrom(m1->p, m3);
+    uint64_t p1p2_inv_mod_p3 = MontPow(MontMul(p1_mod_p3, MontFrom(m2->p, m3), m3), m3->p - 2, m3);
+    uint64_t p1p2 = m1->p * m2->p;
+
+    // Algorytm Garnera: x = x1 + x2 p1 + x3 p1 p2, gdzie xi < pi.
+    for (size_t i = 0; i < len; i++) {
+        uint64_t x1 = residues[i];
+        uint64_t r2 = residues[len + i];
+        uint64_t r3 = residues[2 * len + i];
+
+        uint64_t x1_mod_p2 = x1 % m2->p;
+        uint64_t x2 = MontMul(r2 >= x1_mod_p2 ? r2 - x1_mod_p2 : r2 + m2->p - x1_mod_p2, p1_inv_mod_p2, m2);
+
+        uint64_t sum = x1 % m3->p + MontMul(x2 % m3->p, p1_mod_p3, m3);
+        sum = sum >= m3->p ? sum - m3->p : sum;
+        uint64_t x3 = MontMul(r3 >= sum ? r3 - sum : r3 + m3->p - sum, p1p2_inv_mod_p3, m3);
+
+        // Arytmetyka modulo 2^64 redukuje x do współczynnika.
+        res[i] = x1 + x2 * m1->p + x3 * p1p2;
+    }
+
+    safeFree(residues);
+    safeFree(twiddles);
+    safeFree(fb);
+    safeFree(fa);
+}
+
+void DenseMul(const dense_coeff_t *a, size_t n, const dense_coeff_t *b, size_t m, dense_coeff_t *res) {
+    if ((n < m ? n : m) >= DENSE_NTT_CUTOFF) {
+        DenseMulNtt(a, n, b, m, res);
+    }
+    else {
+        DenseMulKaratsuba(a, n, b, m, res);
+    }
+}
@@ -0,0 +1,85 @@
+/** @file
+ * Interfejs operacji na gęstych wielomianach jednej zmiennej o stałych współczynnikach.
+ *
+ * Gęsty wielomian stopnia @f$ n-1 @f$ to tablica @f$ n @f$ współczynników,
+ * indeksowana wykładnikami. Używa go wewnętrznie poly.c, gdy warstwa wielomianu
+ * ma prawie wszystkie wykładniki, a poly.h widzi tylko postać rzadką.
+ * Arytmetyka jest modulo @f$ 2^{64} @f$, czyli taka sama jak zawijanie się
+ * obliczeń na poly_coeff_t.
+
+  @author Mikołaj Uzarski
+  @date 2021
+*/
+
+#ifndef __DENSE_H__
+#define __DENSE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Typ współczynników gęstego wielomianu (arytmetyka modulo @f$ 2^{64} @f$). */
+typedef uint64_t dense_coeff_t;
+
+/**
+ * Rozmiar, poniżej którego mnożenie Karatsuby przechodzi na mnożenie szkolne.
+ */
+#define DENSE_KARATSUBA_CUTOFF 32
+
+/**
+ * Rozmiar krótszego czynnika, od którego mnożenie przez NTT jest szybsze od Karatsuby
+ * (punkt przecięcia z pomiaru poly_bench).
+ */
+#define DENSE_NTT_CUTOFF 8192
+
+/**
+ * Dodaje do wielomianu @p a wielomian @p b.
+ * @param[in,out] a : tablica @p n współczynników
+ * @param[in] b : tablica @p n współczynników
+ * @param[in] n : liczba współczynników
+ */
+void DenseAdd(dense_coeff_t *a, const dense_coeff_t *b, size_t n);
+
+/**
+ * Odejmuje od wielomianu @p a wielomian @p b.
+ * @param[in,out] a : tablica @p n współczynników
+ * @param[in] b : tablica @p n współczynników
+ * @param[in] n : liczba współczynników
+ */
+void DenseSub(dense_coeff_t *a, const dense_coeff_t *b, size_t n);
+
+/**
+ * Mnoży wielomiany @p a i @p b algorytmem Karatsuby (dla małych wielomianów szkolnym).
+ * @param[in] a : tablica @p n współczynników
+ * @param[in] n : liczba współczynników @p a, dodatnia
+ * @param[in] b : tablica @p m współczynników
+ * @param[in] m : liczba współczynników @p b, dodatnia
+ * @param[out] res : tablica na @f$ n+m-1 @f$ współczynników iloczynu
+ */
+void DenseMulKaratsuba(const dense_coeff_t *a, size_t n, const dense_coeff_t *b, size_t m, dense_coeff_t *res);
+
+/**
+ * Mnoży wielomiany @p a i @p b przez szybką transformatę teorioliczbową (NTT)
+ * modulo trzy liczby pierwsze mniejsze od @f$ 2^{62} @f$.
+ * Współczynniki iloczynu (jako liczby naturalne) są mniejsze od iloczynu tych liczb,
+ * więc chińskie twierdzenie o resztach odtwarza je dokładnie, a potem redukujemy je
+ * modulo @f$ 2^{64} @f$.
+ * @param[in] a : tablica @p n współczynników
+ * @param[in] n : liczba współczynników @p a, dodatnia
+ * @param[in] b : tablica @p m współczynników
+ * @param[in] m : liczba współczynników @p b, dodatnia
+ * @param[out] res : tablica na @f$ n+m-1 @f$ współczynników iloczynu
+ */
+void DenseMulNtt(const dense_coeff_t *a, size_t n, const dense_coeff_t *b, size_t m, dense_coeff_t *res);
+
+/**
+ * Mnoży wielomiany @p a i @p b, wybierając algorytm według ich rozmiaru
+ * (NTT od DENSE_NTT_CUTOFF współczynników krótszego z nich, wcześniej Karatsuba).
+ * @param[in] a : tablica @p n współczynników
+ * @param[in] n : liczba współczynników @p a, dodatnia
+ * @param[in] b : tablica @p m współczynników
+ * @param[in] m : liczba współczynników @p b, dodatnia
+ * @param[out] res : tablica na @f$ n+m-1 @f$ współczynników iloczynu
+ */
+void DenseMul(const dense_coeff_t *a, size_t n, const dense_coeff_t *b, size_t m, dense_coeff_t *res);
+
+#endif /* __DENSE_H__ */
@@ -0,0 +1,427 @@
+/** @file
+ * Implementacja interfejsu flat.h (bez konwersji z drzewa Poly i do niego,
+ * które są w poly.c, bo korzystają z wewnętrznej reprezentacji wielomianów).
+
+  @author Mikołaj Uzarski
+  @date 2021
+*/
+
+#include <string.h>
+#include "flat.h"
+#include "safe_alloc.h"
+
+unsigned FlatBits(uint64_t max_exp) {
+    if (max_exp < ((uint64_t) 1 << 8))
+        return 8;
+    if (max_exp < ((uint64_t) 1 << 16))
+        return 16;
+    return 32;
+}
+
+FlatPoly FlatCreate(size_t vars, unsigned bits, size_t capacity) {
+    size_t per_word = 64 / bits;
+    size_t words = vars == 0 ? 1 : (vars + per_word - 1) / per_word;
+    if (capacity == 0)
+        capacity = 1;
+
+    return (FlatPoly) {
+        .size = 0,
+        .capacity = capacity,
+        .vars = vars,
+        .bits = bits,
+        .words = words,
+        .exps = (uint64_t*) safeMalloc(sizeof(uint64_t) * words * capacity),
+        .coeffs = (poly_coeff_t*) safeMalloc(sizeof(poly_coeff_t) * capacity)
+    };
+}
+
+void FlatDestroy(FlatPoly *f) {
+    safeFree(f->exps);
+    safeFree(f->coeffs);
+}
+
+/**
+ * Zapewnia miejsce na kolejny wyraz wielomianu płaskiego.
+ * @param[in,out] f : wielomian płaski
+ */
+static void FlatReserve(FlatPoly *f) {
+    if (f->size < f->capacity)
+        return;
+
+    f->capacity *= 2;
+    f->exps = (uint64_t*) safeRealloc(f->exps, sizeof(uint64_t) * f->words * f->capacity);
+    f->coeffs = (poly_coeff_t*) safeRealloc(f->coeffs, sizeof(poly_coeff_t) * f->capacity);
+}
+
+/**
+ * Dopisuje wyraz o upakowanych wykładnikach na koniec wielomianu płaskiego.
+ * @param[in,out] f : wielomian płaski
+ * @param[in] exps : wektor wykładników, @p f->words słów
+ * @param[in] coeff : współczynnik
+ */
+static void FlatPushPacked(FlatPoly *f, const uint64_t *exps, poly_coeff_t coeff) {
+    FlatReserve(f);
+    memcpy(&f->exps[f->size * f->words], exps, sizeof(uint64_t) * f->words);
+    f->coeffs[f->size++] = coeff;
+}
+
+void FlatPush(FlatPoly *f, const poly_exp_t exps[], poly_coeff_t coeff) {
+    FlatReserve(f);
+
+    size_t per_word = 64 / f->bits;
+    uint64_t *packed = &f->exps[f->size * f->words];
+    memset(packed, 0, sizeof(uint64_t) * f->words);
+
+    for (size_t var = 0; var < f->vars; var++) {
+        packed[var / per_word] |= (uint64_t) exps[var] << (64 - f->bits * (var % per_word + 1));
+    }
+    f->coeffs[f->size++] = coeff;
+}
+
+poly_exp_t FlatGetExp(const FlatPoly *f, size_t term, size_t var) {
+    size_t per_word = 64 / f->bits;
+    uint64_t word = f->exps[term * f->words + var / per_word];
+    uint64_t mask = ((uint64_t) 1 << f->bits) - 1;
+
+    return (poly_exp_t) ((word >> (64 - f->bits * (var % per_word + 1))) & mask);
+}
+
+/**
+ * Daje największy wykładnik wielomianu płaskiego.
+ * @param[in] f : wielomian płaski
+ * @return największy wykładnik, 0 dla wielomianu stałego
+ */
+static uint64_t FlatMaxExp(const FlatPoly *f) {
+    uint64_t result = 0;
+
+    for (size_t term = 0; term < f->size; term++) {
+        for (size_t var = 0; var < f->vars; var++) {
+            uint64_t exp = (uint64_t) FlatGetExp(f, term, var);
+            if (exp > result)
+                result = exp;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Daje wielomian płaski @p f w zadanym upakowaniu, kopiując go tylko w razie potrzeby.
+ * @param[in] f : wielomian płaski
+ * @param[in] vars : liczba zmiennych, co najmniej @p f->vars
+ * @param[in] bits : liczba bitów wykładnika, mieszcząca wykładniki @p f
+ * @param[out] copy : miejsce na kopię
+ * @return @p f albo @p copy, jeśli trzeba było przepakować (wtedy należy ją usunąć)
+ */
+static const FlatPoly* FlatWithLayout(const FlatPoly *f, size_t vars, unsigned bits, FlatPoly *copy) {
+    if (f->vars == vars && f->bits == bits)
+        return f;
+
+    *copy = FlatCreate(vars, bits, f->size);
+    poly_exp_t *exps = (poly_exp_t*) safeMalloc(sizeof(poly_exp_t) * (vars + 1));
+
+    for (size_t term = 0; term < f->size; term++) {
+        for (size_t var = 0; var < vars; var++) {
+            exps[var] = var < f->vars ? FlatGetExp(f, term, var) : 0;
+        }
+        FlatPush(copy, exps, f->coeffs[term]);
+    }
+
+    safeFree(exps);
+    return copy;
+}
+
+/**
+ * Porównuje upakowane jednomiany.
+ * @param[in] a : wektor wykładników
+ * @param[in] b : wektor wykładników
+ * @param[in] words : liczba słów wektorów
+ * @return liczba ujemna, zero albo dodatnia, gdy @p a jest odpowiednio mniejszy, równy albo większy od @p b
+ */
+static int FlatCmp(const uint64_t *a, const uint64_t *b, size_t words) {
+    for (size_t i = 0; i < words; i++) {
+        if (a[i] != b[i])
+            return a[i] > b[i] ? 1 : -1;
+    }
+    return 0;
+}
+
+FlatPoly FlatAdd(const FlatPoly *f, const FlatPoly *g) {
+    size_t vars = f->vars > g->vars ? f->vars : g->vars;
+    unsigned bits = f->bits > g->bits ? f->bits : g->bits;
+
+    FlatPoly copy_f, copy_g;
+    const FlatPoly *a = FlatWithLayout(f, vars, bits, &copy_f);
+    const FlatPoly *b = FlatWithLayout(g, vars, bits, &copy_g);
+    size_t words = a->words;
+
+    FlatPoly result = FlatCreate(vars, bits, a->size + b->size);
+    size_t i = 0, j = 0;
+
+    while (i < a->size || j < b->size) {
+        int cmp = i == a->size ? -1 : j == b->size ? 1 : FlatCmp(&a->exps[i * words], &b->exps[j * words], words);
+
+        if (cmp > 0) {
+            FlatPushPacked(&result, &a->exps[i * words], a->coeffs[i]);
+            i++;
+        }
+        else if (cmp < 0) {
+            FlatPushPacked(&result, &b->exps[j * words], b->coeffs[j]);
+            j++;
+        }
+        else {
+            poly_coeff_t sum = (poly_coeff_t) ((uint64_t) a->coeffs[i] + (uint64_t) b->coeffs[j]);
+            if (sum != 0)
+                FlatPushPacked(&result, &a->exps[i * words], sum);
+            i++;
+            j++;
+        }
+    }
+
+    if (a == &copy_f)
+        FlatDestroy(&copy_f);
+    if (b == &copy_g)
+        FlatDestroy(&copy_g);
+
+    return result;
+}
+
+FlatPoly FlatNeg(const FlatPoly *f) {
+    FlatPoly result = FlatCreate(f->vars, f->bits, f->size);
+
+    memcpy(result.exps, f->exps, sizeof(uint64_t) * f->words * f->size);
+    for (size_t i = 0; i < f->size; i++) {
+        result.coeffs[i] = (poly_coeff_t) (0 - (uint64_t) f->coeffs[i]);
+    }
+    result.size = f->size;
+
+    return result;
+}
+
+/**
+ * Przywraca własność kopca (maksimum klucza w korzeniu) po zmianie korzenia.
+ * Elementami kopca są indeksy wyrazów pierwszego czynnika, ich klucze są w @p keys.
+ * @param[in,out] heap : kopiec
+ * @param[in] size : liczba elementów kopca
+ * @param[in] keys : upakowane jednomiany iloczynów, @p words słów na indeks
+ * @param[in] words : liczba słów klucza
+ */
+static void FlatHeapSiftDown(size_t *heap, size_t size, const uint64_t *keys, size_t words) {
+    if (size == 0)
+        return;
+
+    size_t i = 0;
+    size_t item = heap[0];
+
+    while (2 * i + 1 < size) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < size && FlatCmp(&keys[heap[child + 1] * words], &keys[heap[child] * words], words) > 0)
+            child++;
+        if (FlatCmp(&keys[heap[child] * words], &keys[item * words], words) <= 0)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = item;
+}
+
+/**
+ * Element kopca w mnożeniu wielomianów płaskich o jednym słowie wykładników.
+ */
+typedef struct FlatHeapItem {
+    /** Upakowany jednomian iloczynu. */
+    uint64_t key;
+    /** Indeks wyrazu pierwszego czynnika. */
+    size_t i;
+} FlatHeapItem;
+
+/**
+ * Przywraca własność kopca po zmianie korzenia (wersja dla jednego słowa wykładników,
+ * klucze są w elementach kopca, więc porównania nie sięgają do innych tablic).
+ * @param[in,out] heap : kopiec
+ * @param[in] size : liczba elementów kopca
+ */
+static void FlatHeapItemSiftDown(FlatHeapItem *heap, size_t size) {
+    if (size == 0)
+        return;
+
+    size_t i = 0;
+    FlatHeapItem item = heap[0];
+
+    while (2 * i + 1 < size) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < size && heap[child + 1].key > heap[child].key)
+            child++;
+        if (heap[child].key <= item.key)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = item;
+}
+
+/**
+ * Wstawia element do kopca, nie ruszając korzenia (jest on zaraz zmieniany przez wywołującego).
+ * @param[in,out] heap : kopiec
+ * @param[in] size : liczba elementów kopca przed wstawieniem, dodatnia
+ * @param[in] item : element
+ */
+static void FlatHeapItemPush(FlatHeapItem *heap, size_t size, FlatHeapItem item) {
+    size_t i = size;
+
+    while (i > 1 && heap[(i - 1) / 2].key < item.key) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    heap[i] = item;
+}
+
+/**
+ * Mnoży wielomiany płaskie o jednym słowie wykładników (najczęstszy przypadek).
+ * @param[in] a : wielomian płaski, krótszy czynnik
+ * @param[in] b : wielomian płaski w tym samym upakowaniu
+ * @param[in,out] result : pusty wielomian płaski na iloczyn
+ */
+static void FlatMulOneWord(const FlatPoly *a, const FlatPoly *b, FlatPoly *result) {
+    FlatHeapItem *heap = (FlatHeapItem*) safeMalloc(sizeof(FlatHeapItem) * a->size);
+    size_t *next = (size_t*) safeMalloc(sizeof(size_t) * a->size);
+
+    // Wiersz i + 1 nie może dać największego iloczynu przed pierwszym iloczynem wiersza i,
+    // więc trafia do kopca dopiero wtedy (kopiec jest mniejszy).
+    heap[0] = (FlatHeapItem) {.key = a->exps[0] + b->exps[0], .i = 0};
+    next[0] = 0;
+    size_t heap_size = 1;
+
+    while (heap_size > 0) {
+        uint64_t key = heap[0].key;
+        uint64_t sum = 0;
+
+        // Sumujemy od razu wszystkie iloczyny o tym samym jednomianie.
+        while (heap_size > 0 && heap[0].key == key) {
+            size_t i = heap[0].i;
+            sum += (uint64_t) a->coeffs[i] * (uint64_t) b->coeffs[next[i]];
+
+            if (next[i] == 0 && i + 1 < a->size) {
+                next[i + 1] = 0;
+                FlatHeapItemPush(heap, heap_size++, (FlatHeapItem) {.key = a->exps[i + 1] + b->exps[0], .i = i + 1});
+            }
+
+            if (++next[i] < b->size)
+                heap[0].key = a->exps[i] + b->exps[next[i]];
+            else
+                heap[0] = heap[--heap_size];
+            FlatHeapItemSiftDown(heap, heap_size);
+        }
+
+        if (sum != 0)
+            FlatPushPacked(result, &key, (poly_coeff_t) sum);
+    }
+
+    safeFree(next);
+    safeFree(heap);
+}
+
+FlatPoly FlatMul(const FlatPoly *f, const FlatPoly *g) {
+    size_t vars = f->vars > g->vars ? f->vars : g->vars;
+    // Wykładniki iloczynu nie przekraczają sumy największych wykładników.
+    unsigned bits = FlatBits(FlatMaxExp(f) + FlatMaxExp(g));
+
+    FlatPoly copy_f, copy_g;
+    const FlatPoly *a = FlatWithLayout(f, vars, bits, &copy_f);
+    const FlatPoly *b = FlatWithLayout(g, vars, bits, &copy_g);
+    size_t words = a->words;
+
+    // Krótszy czynnik wyznacza rozmiar kopca.
+    if (a->size > b->size) {
+        const FlatPoly *tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    FlatPoly result = FlatCreate(vars, bits, a->size + b->size);
+
+    if (a->size > 0 && b->size > 0 && words == 1) {
+        FlatMulOneWord(a, b, &result);
+    }
+    else if (a->size > 0 && b->size > 0) {
+        size_t *heap = (size_t*) safeMalloc(sizeof(size_t) * a->size);
+        size_t *next = (size_t*) safeMalloc(sizeof(size_t) * a->size);
+        uint64_t *keys = (uint64_t*) safeMalloc(sizeof(uint64_t) * words * a->size);
+        size_t heap_size = a->size;
+
+        // Dodanie słów dodaje wykładniki, bo pola mają miejsce na sumy.
+        // Wyrazy a są malejące, więc kopiec od razu jest poprawny.
+        for (size_t i = 0; i < a->size; i++) {
+            heap[i] = i;
+            next[i] = 0;
+            for (size_t w = 0; w < words; w++)
+                keys[i * words + w] = a->exps[i * words + w] + b->exps[w];
+        }
+
+        while (heap_size > 0) {
+            size_t i = heap[0];
+            const uint64_t *key = &keys[i * words];
+            poly_coeff_t product = (poly_coeff_t) ((uint64_t) a->coeffs[i] * (uint64_t) b->coeffs[next[i]]);
+
+            // Iloczyny wychodzą malejąco, równe jednomiany trafiają na koniec wyniku.
+            if (result.size > 0 && FlatCmp(&result.exps[(result.size - 1) * words], key, words) == 0) {
+                result.coeffs[result.size - 1] =
+                    (poly_coeff_t) ((uint64_t) result.coeffs[result.size - 1] + (uint64_t) product);
+            }
+            else {
+                // Poprzedni wyraz się wyzerował.
+                if (result.size > 0 && result.coeffs[result.size - 1] == 0)
+                    result.size--;
+                FlatPushPacked(&result, key, product);
+            }
+
+            if (++next[i] < b->size) {
+                for (size_t w = 0; w < words; w++)
+                    keys[i * words + w] = a->exps[i * words + w] + b->exps[next[i] * words + w];
+            }
+            else {
+                heap[0] = heap[--heap_size];
+            }
+            FlatHeapSiftDown(heap, heap_size, keys, words);
+        }
+
+        if (result.size > 0 && result.coeffs[result.size - 1] == 0)
+            result.size--;
+
+        safeFree(keys);
+        safeFree(next);
+        safeFree(heap);
+    }
+
+    if (a == &copy_f || b == &copy_f)
+        FlatDestroy(&copy_f);
+    if (a == &copy_g || b == &copy_g)
+        FlatDestroy(&copy_g);
+
+    return result;
+}
+
+bool FlatIsEq(const FlatPoly *f, const FlatPoly *g) {
+    if (f->size != g->size)
+        return false;
+
+    size_t vars = f->vars > g->vars ? f->vars : g->vars;
+    unsigned bits = f->bits > g->bits ? f->bits : g->bits;
+
+    FlatPoly copy_f, copy_g;
+    const FlatPoly *a = FlatWithLayout(f, vars, bits, &copy_f);
+    const FlatPoly *b = FlatWithLayout(g, vars, bits, &copy_g);
+
+    bool result = memcmp(a->coeffs, b->coeffs, sizeof(poly_coeff_t) * a->size) == 0 &&
+                  memcmp(a->exps, b->exps, sizeof(uint64_t) * a->words * a->size) == 0;
+
+    if (a == &copy_f)
+        FlatDestroy(&copy_f);
+    if (b == &copy_g)
+        FlatDestroy(&copy_g);
+
+    return result;
+}
@@ -0,0 +1,128 @@
+/** @file
+ * Interfejs rozproszonej (płaskiej) reprezentacji wielomianów.
+ *
+ * Wielomian płaski to równoległe tablice wektorów wykładników i współczynników
+ * jego wyrazów, posortowane malejąco w porządku leksykograficznym (od @f$ x_0 @f$),
+ * czyli w tej samej kolejności, w jakiej wyrazy występują w drzewie Poly.
+ * Wykładniki jednego wyrazu są upakowane po kilka w 64-bitowych słowach
+ * (po 8, 16 albo 32 bity), @f$ x_0 @f$ w najstarszych bitach pierwszego słowa,
+ * więc porównanie słów jako liczb porównuje jednomiany, a dodanie słów mnoży je.
+ * Cały wielomian to dwie alokacje, niezależnie od liczby zmiennych.
+ * Arytmetyka współczynników zawija się modulo @f$ 2^{64} @f$, tak jak na poly_coeff_t.
+
+  @author Mikołaj Uzarski
+  @date 2021
+*/
+
+#ifndef __FLAT_H__
+#define __FLAT_H__
+
+#include <stdint.h>
+#include "poly.h"
+
+/**
+ * Struktura przechowująca wielomian płaski.
+ */
+typedef struct FlatPoly {
+    /** Liczba wyrazów. */
+    size_t size;
+    /** Rozmiar tablic (liczba wyrazów, które się w nich mieszczą). */
+    size_t capacity;
+    /** Liczba zmiennych. */
+    size_t vars;
+    /** Liczba bitów jednego wykładnika: 8, 16 albo 32. */
+    unsigned bits;
+    /** Liczba słów wektora wykładników jednego wyrazu. */
+    size_t words;
+    /** Wektory wykładników, @p words słów na wyraz. */
+    uint64_t *exps;
+    /** Współczynniki, niezerowe. */
+    poly_coeff_t *coeffs;
+} FlatPoly;
+
+/**
+ * Daje najmniejszą liczbę bitów wykładnika, w której mieści się @p max_exp.
+ * @param[in] max_exp : największy wykładnik
+ * @return 8, 16 albo 32
+ */
+unsigned FlatBits(uint64_t max_exp);
+
+/**
+ * Tworzy pusty wielomian płaski (zerowy).
+ * @param[in] vars : liczba zmiennych
+ * @param[in] bits : liczba bitów jednego wykładnika
+ * @param[in] capacity : początkowy rozmiar tablic
+ * @return wielomian płaski
+ */
+FlatPoly FlatCreate(size_t vars, unsigned bits, size_t capacity);
+
+/**
+ * Usuwa wielomian płaski z pamięci.
+ * @param[in] f : wielomian płaski
+ */
+void FlatDestroy(FlatPoly *f);
+
+/**
+ * Dopisuje wyraz na koniec wielomianu płaskiego. Wyraz musi być mniejszy od
+ * dotychczasowych, a jego wykładniki mieścić się w @p f->bits bitach.
+ * @param[in,out] f : wielomian płaski
+ * @param[in] exps : wykładniki kolejnych zmiennych, @p f->vars liczb
+ * @param[in] coeff : niezerowy współczynnik
+ */
+void FlatPush(FlatPoly *f, const poly_exp_t exps[], poly_coeff_t coeff);
+
+/**
+ * Daje wykładnik zmiennej w wyrazie wielomianu płaskiego.
+ * @param[in] f : wielomian płaski
+ * @param[in] term : indeks wyrazu
+ * @param[in] var : indeks zmiennej, mniejszy od @p f->vars
+ * @return wykładnik
+ */
+poly_exp_t FlatGetExp(const FlatPoly *f, size_t term, size_t var);
+
+/**
+ * Dodaje dwa wielomiany płaskie.
+ * @param[in] f : wielomian płaski
+ * @param[in] g : wielomian płaski
+ * @return @f$ f + g @f$
+ */
+FlatPoly FlatAdd(const FlatPoly *f, const FlatPoly *g);
+
+/**
+ * Zwraca przeciwny wielomian płaski.
+ * @param[in] f : wielomian płaski
+ * @return @f$ -f @f$
+ */
+FlatPoly FlatNeg(const FlatPoly *f);
+
+/**
+ * Mnoży dwa wielomiany płaskie (algorytmem Johnsona, na upakowanych wykładnikach).
+ * @param[in] f : wielomian płaski
+ * @param[in] g : wielomian płaski
+ * @return @f$ f * g @f$
+ */
+FlatPoly FlatMul(const FlatPoly *f, const FlatPoly *g);
+
+/**
+ * Sprawdza równość dwóch wielomianów płaskich.
+ * @param[in] f : wielomian płaski
+ * @param[in] g : wielomian płaski
+ * @return @f$ f = g @f$
+ */
+bool FlatIsEq(const FlatPoly *f, const FlatPoly *g);
+
+/**
+ * Zamienia wielomian na wielomian płaski.
+ * @param[in] p : wielomian
+ * @return wielomian płaski
+ */
+FlatPoly PolyToFlat(const Poly *p);
+
+/**
+ * Zamienia wielomian płaski na wielomian.
+ * @param[in] f : wielomian płaski
+ * @return wielomian
+ */
+Poly PolyFromFlat(const FlatPoly *f);
+
+#endif /* __FLAT_H__ */
@@ -15,6 +15,8 @@
 #include <ctype.h>
 #include "poly.h"
 #include "stack.h"
+#include "safe_alloc.h"
+#include "trace.h"
 
 /**
  * Dynamiczna struktura (vector) przechowująca jednomiany.
@@ -55,7 +57,7 @@ static void VecAdd(MonoVec *v, Mono *m) {
  * @param[in] v : vector
  */
 static void VecDestroy(MonoVec *v) {
-    free(v->monos);
+    safeFree(v->monos);
 }
 
 /**
@@ -68,7 +70,7 @@ static void VecError(MonoVec *v) {
     for (size_t i = 0; i < v->size; i++) {
         MonoDestroy(&v->monos[i]);
     }
-    free(v->monos);
+    safeFree(v->monos);
 }
 
 /**
@@ -419,10 +421,37 @@ Poly PolyFromString(char *buffer, size_t *cur, size_t line) {
     }
 }
 
-void HandleLine(char *buffer, size_t line, Stack *s, size_t len, size_t characters) {
-    if (CheckIfEmptyOrComment(buffer))
-        return;
+/**
+ * Zwraca nazwę komendy zapisanej w wierszu, używaną w śladzie wykonania (trace.h).
+ * Wiersze z wielomianami nazywane są "POLY".
+ * @param[in] buffer : wiersz
+ * @return nazwa komendy (literał napisowy)
+ */
+static const char* CommandName(const char *buffer) {
+    static const char *commands[] = {"ZERO", "IS_COEFF", "IS_ZERO", "CLONE", "ADD", "MUL", "NEG", "SUB",
+                                     "IS_EQ", "DEG_BY", "DEG", "AT", "PRINT", "POP", "COMPOSE"};
+
+    if (!CheckIfLetter(buffer[0]))
+        return "POLY";
+
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        size_t len = strlen(commands[i]);
+        if (strncmp(buffer, commands[i], len) == 0 && !isalpha(buffer[len]) && buffer[len] != '_')
+            return commands[i];
+    }
+
+    return "WRONG COMMAND";
+}
 
+/**
+ * Wykonuje komendę lub wstawia na stos wielomian zapisany w wierszu.
+ * @param[in] buffer : wiersz
+ * @param[in] line : numer wiersza
+ * @param[in] s : stos
+ * @param[in] len : długość wiersza do (pierwszego znaku '\0')
+ * @param[in] characters : długość wiersza
+ */
+static void ExecuteLine(char *buffer, size_t line, Stack *s, size_t len, size_t characters) {
     if (CheckIfLetter(buffer[0])) {
         char last = buffer[len - 1];
         if (CheckIfDegBy(buffer, len, characters)) {
@@ -509,4 +538,15 @@ void HandleLine(char *buffer, size_t line, Stack *s, size_t len, size_t characte
     Poly p = PolyFromString(buffer, &cur, line);
     if (errno != ERANGE)
         StackPut(s, &p);
+}
+
+void HandleLine(char *buffer, size_t line, Stack *s, size_t len, size_t characters) {
+    if (CheckIfEmptyOrComment(buffer))
+        return;
+
+    // Każda komenda jest osobnym przedziałem w śladzie wykonania.
+    const char *name = trace_enabled() ? CommandName(buffer) : NULL;
+    trace_begin(name);
+    ExecuteLine(buffer, line, s, len, characters);
+    trace_end(name);
 }
\ No newline at end of file
@@ -5,7 +5,24 @@
  * Niezmienniki w implementacji wielomianów: \n
  *  1) Tablica jednomianów wielomianu posortowana jest malejąco po wykładnikach. \n
  *  2) Jeśli wielomian jest współczynnikiem (coeff), to trzymany jest jako (Poly) {.arr = NULL, .coeff = coeff}.
- *  Pozwala to na ujednoznacznienie reprezentacji takich wielomianów.
+ *  Pozwala to na ujednoznacznienie reprezentacji takich wielomianów. \n
+ *  3) Tablice jednomianów są współdzielone przez kopie wielomianów (licznik referencji w nagłówku
+ *  tablicy). Tablicę można zmieniać tylko wtedy, gdy nie jest współdzielona (PolyMakeUnique). \n
+ *  4) W trybie hash-consingu (PolyHashConsing) tablice są internowane: w globalnej słabej tablicy
+ *  haszującej (nie zwiększa liczników referencji) każda internowana tablica ma różną treść.
+ *  Tablica jest internowana tylko wtedy, gdy wszystkie jej współczynniki są liczbami lub
+ *  internowanymi wielomianami, więc internowane wielomiany są równe wtedy i tylko wtedy,
+ *  gdy mają tę samą tablicę.
+ *
+ * Tablica jednomianów jest trzymana jako struktura tablic: ciągła tablica wykładników
+ * (na nią wskazuje pole arr), a za nią w tej samej alokacji tablica współczynników (MonosCoeffs).
+ * Tablica, której wszystkie współczynniki są liczbami, jest zawsze liściem: zamiast wielomianów
+ * trzyma same liczby (LeafCoeffs), a operacje na niej to proste pętle po dwóch tablicach.
+ *
+ * PolyDestroy działa w stałym czasie: tablica, której nikt już nie używa, trafia na listę
+ * tablic do zwolnienia wątku, a jej współczynniki są zwalniane po kilka przy kolejnych
+ * alokacjach, które w miarę możliwości dostają pamięć zwolnionej tablicy. Tablice tymczasowe
+ * (kopce mnożenia, kopie jednomianów) leżą na stosie pamięci tymczasowej wątku (ScratchAlloc).
 
   @author Mikołaj Uzarski
   @date 2021
@@ -15,502 +32,1927 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <string.h>
+#include <stdint.h>
 #include "poly.h"
+#include "dense.h"
+#include "flat.h"
+#include "safe_alloc.h"
 #include <stdio.h>
 
 /**
- * Asercje czy dany wielomian jest poprawnie reprezentowany.
- * Sprawdza między innymi niezmiennik 2).
- * @param[in] p : wielomian
- * @return bool : sprawdzenie poprawności reprezentacji wielomianu @p p
+ * Nagłówek tablicy jednomianów, umieszczony w pamięci tuż przed nią.
+ * Licznik referencji nie jest atomowy, wielomiany nie są współdzielone między wątkami.
  */
-static bool PolyCheckIfCorrect(const Poly *p) {
-    bool result = p != NULL;
-    if (!PolyIsCoeff(p)) {
-        result = result && !(PolyIsCoeff(&p->arr[0].p) && MonoGetExp(&p->arr[0]) == 0);
-    }
-    return result;
+typedef struct MonosHeader {
+    /** Liczba wielomianów korzystających z tablicy. */
+    size_t refs;
+    /** Rozmiar tablicy (liczba jednomianów, które się w niej mieszczą). */
+    size_t capacity;
+    /** Liczba jednomianów internowanej tablicy albo tablicy czekającej na zwolnienie. */
+    size_t size;
+    /** Skrót internowanej tablicy. */
+    size_t hash;
+    /** Następna tablica w kubełku tablicy haszującej albo na liście tablic do zwolnienia. */
+    struct MonosHeader *next;
+    /** Czy tablica jest internowana? */
+    bool interned;
+    /** Czy tablica jest liściem (współczynniki są liczbami typu poly_coeff_t)? */
+    bool leaf;
+} MonosHeader;
+
+/**
+ * Początkowa liczba kubełków tablicy haszującej internowanych tablic.
+ */
+#define INTERN_INITIAL_BUCKETS 1024
+
+/** Czy nowe tablice są internowane? */
+static bool hash_consing = false;
+/** Kubełki tablicy haszującej internowanych tablic. */
+static MonosHeader **intern_buckets = NULL;
+/** Liczba kubełków. */
+static size_t intern_buckets_count = 0;
+/** Liczba internowanych tablic. */
+static size_t intern_size = 0;
+
+/**
+ * Największa liczba tablic do zwolnienia przeglądanych przy jednej alokacji.
+ * Co najmniej 2, żeby lista tablic do zwolnienia nie rosła szybciej, niż jest opróżniana.
+ */
+#define GARBAGE_STEPS 2
+
+/**
+ * Lista tablic, których licznik referencji spadł do zera, a ich współczynniki
+ * nie zostały jeszcze zwolnione (PolyDestroy tylko dopisuje tablicę do listy).
+ */
+static _Thread_local MonosHeader *garbage = NULL;
+
+/**
+ * Nagłówek kawałka pamięci tymczasowej (stosu tymczasowych tablic wątku).
+ */
+typedef struct ScratchChunk {
+    /** Poprzedni (starszy) kawałek. */
+    struct ScratchChunk *prev;
+    /** Liczba bajtów kawałka (bez nagłówka). */
+    size_t size;
+    /** Liczba zajętych bajtów. */
+    size_t used;
+} ScratchChunk;
+
+/**
+ * Najmniejszy rozmiar kawałka pamięci tymczasowej.
+ */
+#define SCRATCH_CHUNK_SIZE ((size_t) 1 << 16)
+
+/**
+ * Największy rozmiar pustego kawałka pamięci tymczasowej zachowywanego do ponownego użycia.
+ */
+#define SCRATCH_MAX_KEPT ((size_t) 1 << 24)
+
+/**
+ * Wyrównanie tablic z pamięci tymczasowej (takie jak malloc).
+ */
+#define SCRATCH_ALIGNMENT 16
+
+/**
+ * Odległość danych kawałka pamięci tymczasowej od jego początku (nagłówek z wyrównaniem).
+ */
+#define SCRATCH_HEADER ((sizeof(ScratchChunk) + SCRATCH_ALIGNMENT - 1) & ~(size_t) (SCRATCH_ALIGNMENT - 1))
+
+/** Najnowszy kawałek pamięci tymczasowej wątku. */
+static _Thread_local ScratchChunk *scratch = NULL;
+/** Pusty kawałek zachowany do ponownego użycia. */
+static _Thread_local ScratchChunk *scratch_spare = NULL;
+
+/**
+ * Daje liczbę miejsc na wykładniki przed współczynnikami tablicy jednomianów
+ * (zaokrągloną w górę do parzystej, żeby współczynniki były wyrównane).
+ * @param[in] capacity : rozmiar tablicy
+ * @return liczba miejsc na wykładniki
+ */
+static size_t MonosCoeffsOffset(size_t capacity) {
+    return (capacity + 1) & ~(size_t) 1;
 }
 
 /**
- * Komparator jednomianów (porządek malejący po wykładniku)
- * @param[in] a : wskaźnik na pierwszy jednomian
- * @param[in] b : wskaźnik na drugi jednomian
- * @return liczba całkowita : wykładnik b - wykładnik a
+ * Daje liczbę bajtów tablicy jednomianów (bez nagłówka).
+ * @param[in] capacity : rozmiar tablicy
+ * @param[in] leaf : czy tablica jest liściem?
+ * @return liczba bajtów
  */
-static int monoCmp (const void *a, const void *b) {
+static size_t MonosBytes(size_t capacity, bool leaf) {
+    return sizeof(poly_exp_t) * MonosCoeffsOffset(capacity) + (leaf ? sizeof(poly_coeff_t) : sizeof(Poly)) * capacity;
+}
 
-    Mono *m1 = (Mono*) a;
-    Mono *m2 = (Mono*) b;
+/**
+ * Daje nagłówek tablicy jednomianów.
+ * @param[in] arr : tablica wykładników zaalokowana przez MonosAlloc
+ * @return nagłówek tablicy
+ */
+static MonosHeader* MonosGetHeader(const poly_exp_t *arr) {
+    return (MonosHeader*) arr - 1;
+}
 
-    if (m2->exp > m1->exp) {
-        return 1;
-    }
-    else if (m2->exp < m1->exp) {
-        return -1;
-    }
-    else {
-        return 0;
-    }
+/**
+ * Sprawdza, czy tablica jednomianów jest liściem.
+ * @param[in] arr : tablica wykładników zaalokowana przez MonosAllocKind
+ * @return Czy współczynniki tablicy są liczbami?
+ */
+static bool MonosIsLeaf(const poly_exp_t *arr) {
+    return MonosGetHeader(arr)->leaf;
 }
 
 /**
- * Zwraca większą z dwóch liczb całkowitych.
- * @param[in] a : liczba całkowita
- * @param[in] b : liczba całkowita
- * @return liczba całkowita : @f$\max(a,b)@f$
+ * Daje tablicę współczynników jednomianów tablicy niebędącej liściem.
+ * @param[in] arr : tablica wykładników zaalokowana przez MonosAlloc
+ * @return tablica współczynników
  */
-static int max (int a, int b) {
-    if (a >= b)
-        return a;
+static Poly* MonosCoeffs(const poly_exp_t *arr) {
+    assert(!MonosIsLeaf(arr));
+    return (Poly*) (arr + MonosCoeffsOffset(MonosGetHeader(arr)->capacity));
+}
 
-    return b;
+/**
+ * Daje tablicę współczynników liścia.
+ * @param[in] arr : tablica wykładników zaalokowana przez LeafAlloc
+ * @return tablica współczynników
+ */
+static poly_coeff_t* LeafCoeffs(const poly_exp_t *arr) {
+    assert(MonosIsLeaf(arr));
+    return (poly_coeff_t*) (arr + MonosCoeffsOffset(MonosGetHeader(arr)->capacity));
 }
 
 /**
- * Zwraca @p x podniesione do potęgi @p exp.
- * @param[in] x : liczba całkowita
- * @param[in] exp : liczba całkowita, wykładnik
- * @return liczba całkowita @f$ x^{exp} @f$
+ * Daje współczynnik jednomianu tablicy dowolnego rodzaju, bez kopiowania.
+ * @param[in] arr : tablica wykładników zaalokowana przez MonosAllocKind
+ * @param[in] i : indeks jednomianu
+ * @return współczynnik
  */
-static poly_coeff_t power (poly_coeff_t x, poly_exp_t exp) {
+static Poly MonosCoeffAt(const poly_exp_t *arr, size_t i) {
+    return MonosIsLeaf(arr) ? PolyFromCoeff(LeafCoeffs(arr)[i]) : MonosCoeffs(arr)[i];
+}
 
-    poly_coeff_t result = 1;
+/**
+ * Powiększa tablicę jednomianów, przenosząc jej współczynniki na nowe miejsce.
+ * @param[in] arr : tablica wykładników zaalokowana przez MonosAllocKind
+ * @param[in] size : liczba zajętych jednomianów
+ * @param[in] capacity : nowy rozmiar tablicy, nie mniejszy od starego
+ * @return nowa tablica wykładników
+ */
+static poly_exp_t* MonosGrow(poly_exp_t *arr, size_t size, size_t capacity) {
+    bool leaf = MonosIsLeaf(arr);
+    size_t old_offset = MonosCoeffsOffset(MonosGetHeader(arr)->capacity);
+    MonosHeader *header = (MonosHeader*) safeRealloc(MonosGetHeader(arr),
+                                                     sizeof(MonosHeader) + MonosBytes(capacity, leaf));
+    header->capacity = capacity;
+    arr = (poly_exp_t*) (header + 1);
+    memmove(arr + MonosCoeffsOffset(capacity), arr + old_offset,
+            (leaf ? sizeof(poly_coeff_t) : sizeof(Poly)) * size);
+    return arr;
+}
 
-    while (exp > 0) {
-        if (exp % 2 == 0) {
-            x *= x;
-            exp /= 2;
+/**
+ * Zwalnia tablicę jednomianów (bez jej zawartości).
+ * @param[in] arr : tablica wykładników zaalokowana przez MonosAlloc
+ */
+static void MonosFree(poly_exp_t *arr) {
+    safeFree(MonosGetHeader(arr));
+}
+
+/**
+ * Liczy skrót tablicy jednomianów. Wielomiany we współczynnikach są internowane,
+ * więc wystarczą ich adresy.
+ * @param[in] arr : tablica wykładników
+ * @param[in] size : liczba jednomianów
+ * @return skrót
+ */
+static size_t MonosHash(const poly_exp_t *arr, size_t size) {
+    uint64_t hash = (uint64_t) size * 0x9E3779B97F4A7C15u;
+
+    for (size_t i = 0; i < size; i++) {
+        Poly coeff = MonosCoeffAt(arr, i);
+        uint64_t value = PolyIsCoeff(&coeff) ? (uint64_t) coeff.coeff : (uint64_t) (uintptr_t) coeff.arr;
+        hash = (hash ^ (uint64_t) (uint32_t) arr[i]) * 0x100000001B3u;
+        hash = (hash ^ value) * 0x9E3779B97F4A7C15u;
+        hash ^= hash >> 29;
+    }
+
+    return (size_t) hash;
+}
+
+/**
+ * Sprawdza płytką równość tablic jednomianów (współczynniki porównywane są po adresach).
+ * @param[in] a : tablica wykładników
+ * @param[in] b : tablica wykładników
+ * @param[in] size : liczba jednomianów obu tablic
+ * @return Czy tablice są równe?
+ */
+static bool MonosShallowEq(const poly_exp_t *a, const poly_exp_t *b, size_t size) {
+    if (MonosIsLeaf(a) != MonosIsLeaf(b) || memcmp(a, b, sizeof(poly_exp_t) * size) != 0)
+        return false;
+
+    if (MonosIsLeaf(a))
+        return memcmp(LeafCoeffs(a), LeafCoeffs(b), sizeof(poly_coeff_t) * size) == 0;
+
+    const Poly *coeffs_a = MonosCoeffs(a);
+    const Poly *coeffs_b = MonosCoeffs(b);
+    for (size_t i = 0; i < size; i++) {
+        if (coeffs_a[i].arr != coeffs_b[i].arr)
+            return false;
+        if (PolyIsCoeff(&coeffs_a[i]) && coeffs_a[i].coeff != coeffs_b[i].coeff)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Dodaje tablicę do tablicy haszującej, powiększając ją w razie potrzeby.
+ * @param[in] header : nagłówek tablicy z ustawionymi polami size i hash
+ */
+static void InternInsert(MonosHeader *header) {
+    if (intern_size >= intern_buckets_count) {
+        size_t count = intern_buckets_count == 0 ? INTERN_INITIAL_BUCKETS : 2 * intern_buckets_count;
+        MonosHeader **buckets = (MonosHeader**) safeMalloc(sizeof(MonosHeader*) * count);
+        for (size_t i = 0; i < count; i++)
+            buckets[i] = NULL;
+
+        for (size_t i = 0; i < intern_buckets_count; i++) {
+            MonosHeader *cur = intern_buckets[i];
+            while (cur != NULL) {
+                MonosHeader *next = cur->next;
+                cur->next = buckets[cur->hash % count];
+                buckets[cur->hash % count] = cur;
+                cur = next;
+            }
         }
-        exp--;
-        result *= x;
+
+        safeFree(intern_buckets);
+        intern_buckets = buckets;
+        intern_buckets_count = count;
     }
 
-    return result;
+    MonosHeader **bucket = &intern_buckets[header->hash % intern_buckets_count];
+    header->next = *bucket;
+    *bucket = header;
+    header->interned = true;
+    intern_size++;
 }
 
 /**
- * Zwraca wielomian @p p przemnożony przez skalar @p s.
- * @param[in] p : wielomian
- * @param[in] s : liczba całkowita - skalar
- * @return wielomian @f$sp@f$
+ * Usuwa tablicę z tablicy haszującej.
+ * @param[in] header : nagłówek internowanej tablicy
  */
-static Poly PolyMulByScalar(const Poly *p, poly_coeff_t s) {
-    assert(PolyCheckIfCorrect(p));
+static void InternRemove(MonosHeader *header) {
+    MonosHeader **cur = &intern_buckets[header->hash % intern_buckets_count];
+    while (*cur != header)
+        cur = &(*cur)->next;
+
+    *cur = header->next;
+    header->interned = false;
+    intern_size--;
+}
 
-    if (s == 0) {
-        return PolyZero();
+/**
+ * Zmniejsza licznik referencji tablicy; gdy spadnie do zera, usuwa ją z tablicy haszującej
+ * i dopisuje do listy tablic do zwolnienia (w czasie stałym, bez przeglądania współczynników).
+ * @param[in] arr : tablica wykładników
+ * @param[in] size : liczba jednomianów
+ */
+static void MonosRelease(poly_exp_t *arr, size_t size) {
+    MonosHeader *header = MonosGetHeader(arr);
+
+    // Tablica jest zwalniana przez ostatni korzystający z niej wielomian.
+    if (--header->refs > 0) {
+        return;
     }
 
-    if (PolyIsCoeff(p)) {
-        return PolyFromCoeff(s * p->coeff);
+    if (header->interned) {
+        InternRemove(header);
     }
 
-    Mono *monos_tmp = (Mono*) safeMalloc(sizeof (Mono) * (p->size + 1));
+    header->size = size;
+    header->next = garbage;
+    garbage = header;
+}
 
-    size_t size = 0;
-    for (size_t i = 0; i < p->size; i++) {
-        Poly poly_tmp = PolyMulByScalar(&p->arr[i].p, s);
-        if (!PolyIsZero(&poly_tmp)) {
-            monos_tmp[size] = (Mono) {.exp = p->arr[i].exp, .p = poly_tmp};
-            size++;
+/**
+ * Zdejmuje tablicę z listy tablic do zwolnienia i zwalnia jej współczynniki
+ * (ich tablice trafiają na listę, jeśli nikt inny z nich nie korzysta).
+ * @return nagłówek tablicy, której pamięć można użyć ponownie albo zwolnić
+ */
+static MonosHeader* GarbagePop(void) {
+    MonosHeader *header = garbage;
+    garbage = header->next;
+
+    poly_exp_t *arr = (poly_exp_t*) (header + 1);
+    for (size_t i = 0; !header->leaf && i < header->size; i++) {
+        Poly *coeff = &MonosCoeffs(arr)[i];
+        if (!PolyIsCoeff(coeff)) {
+            MonosRelease(coeff->arr, coeff->size);
         }
     }
 
-    if (size == 0) {
-        free(monos_tmp);
-        return PolyZero();
+    return header;
+}
+
+/**
+ * Zwalnia kilka (GARBAGE_STEPS) tablic z listy tablic do zwolnienia, zwracając pierwszą,
+ * której pamięć nadaje się na nową tablicę: ma co najmniej @p bytes bajtów i nie więcej niż dwa razy tyle.
+ * @param[in] bytes : liczba bajtów nowej tablicy z nagłówkiem
+ * @return pamięć na tablicę albo NULL
+ */
+static MonosHeader* GarbageTake(size_t bytes) {
+    for (int step = 0; step < GARBAGE_STEPS && garbage != NULL; step++) {
+        MonosHeader *header = GarbagePop();
+        size_t old_bytes = sizeof(MonosHeader) + MonosBytes(header->capacity, header->leaf);
+
+        if (old_bytes >= bytes && old_bytes <= 2 * bytes) {
+            return header;
+        }
+        safeFree(header);
     }
 
-    // Zachowywanie niezmiennika 2).
-    if (size == 1 && PolyIsCoeff(&monos_tmp[0].p) && MonoGetExp(&monos_tmp[0]) == 0) {
-        Poly coeff = PolyFromCoeff(monos_tmp[0].p.coeff);
-        free(monos_tmp);
-        return coeff;
+    return NULL;
+}
+
+/**
+ * Alokuje tablicę jednomianów z nagłówkiem, z licznikiem referencji równym 1,
+ * w miarę możliwości w pamięci tablicy czekającej na zwolnienie (GarbageTake).
+ * Za nagłówkiem leży ciągła tablica wykładników, a za nią tablica współczynników
+ * (MonosCoeffs albo LeafCoeffs), więc przeglądanie wykładników nie ciągnie
+ * do pamięci podręcznej współczynników.
+ * @param[in] capacity : rozmiar tablicy
+ * @param[in] leaf : czy tablica jest liściem?
+ * @return tablica wykładników jednomianów
+ */
+static poly_exp_t* MonosAllocKind(size_t capacity, bool leaf) {
+    size_t bytes = sizeof(MonosHeader) + MonosBytes(capacity, leaf);
+    MonosHeader *header = GarbageTake(bytes);
+    if (header == NULL) {
+        header = (MonosHeader*) safeMalloc(bytes);
     }
+    header->refs = 1;
+    header->capacity = capacity;
+    header->interned = false;
+    header->leaf = leaf;
+    return (poly_exp_t*) (header + 1);
+}
 
-    return (Poly) {.size = size, .arr = monos_tmp};
+/**
+ * Alokuje tablicę jednomianów o współczynnikach będących wielomianami (MonosAllocKind).
+ * @param[in] capacity : rozmiar tablicy
+ * @return tablica wykładników jednomianów
+ */
+static poly_exp_t* MonosAlloc(size_t capacity) {
+    return MonosAllocKind(capacity, false);
 }
 
 /**
- * Zwraca jednomian @p m przemnożony przez skalar @p s.
- * @param[in] m : jednomian
- * @param[in] s : liczba całkowita - skalar
- * @return jednomian @f$sm@f$
+ * Alokuje liść, czyli tablicę jednomianów o współczynnikach będących liczbami (MonosAllocKind).
+ * @param[in] capacity : rozmiar tablicy
+ * @return tablica wykładników jednomianów
  */
-static Mono MonoMulByScalar(const Mono *m, poly_coeff_t s) {
-    return (Mono) {.exp = m->exp, .p = PolyMulByScalar(&m->p, s)};
+static poly_exp_t* LeafAlloc(size_t capacity) {
+    return MonosAllocKind(capacity, true);
 }
 
 /**
- * Dodaje liczbę całkowitą @p coeff do wielomianu @p p, niebędącego liczbą całkowitą.
- * Modyfikuje wejściowy wielomian.
- * @param[in] p : wielomian
- * @param[in] coeff : liczba całkowita
+ * Daje tablicę z pamięci tymczasowej wątku. Tablice są zwalniane (ScratchFree)
+ * w kolejności odwrotnej do przydziału, więc przydział to przesunięcie wskaźnika.
+ * @param[in] bytes : rozmiar tablicy
+ * @return tablica
  */
-static void PolyAddCoeff (Poly *p, poly_coeff_t coeff) {
-    assert(PolyCheckIfCorrect(p));
-    assert(!PolyIsCoeff(p));
+static void* ScratchAlloc(size_t bytes) {
+    bytes = (bytes + SCRATCH_ALIGNMENT - 1) & ~(size_t) (SCRATCH_ALIGNMENT - 1);
+
+    if (scratch == NULL || scratch->size - scratch->used < bytes) {
+        ScratchChunk *chunk = scratch_spare;
+        scratch_spare = NULL;
+
+        if (chunk == NULL || chunk->size < bytes) {
+            safeFree(chunk);
+            size_t size = SCRATCH_CHUNK_SIZE;
+            while (size < bytes || (scratch != NULL && size < 2 * scratch->size)) {
+                size *= 2;
+            }
+            chunk = (ScratchChunk*) safeMalloc(SCRATCH_HEADER + size);
+            chunk->size = size;
+        }
 
-    if (coeff == 0) {
+        chunk->prev = scratch;
+        chunk->used = 0;
+        scratch = chunk;
+    }
+
+    void *ptr = (char*) scratch + SCRATCH_HEADER + scratch->used;
+    scratch->used += bytes;
+    return ptr;
+}
+
+/**
+ * Oddaje tablicę z pamięci tymczasowej, ostatnią nieoddaną.
+ * @param[in] ptr : tablica z ScratchAlloc
+ */
+static void ScratchFree(void *ptr) {
+    scratch->used = (size_t) ((char*) ptr - ((char*) scratch + SCRATCH_HEADER));
+
+    if (scratch->used > 0) {
         return;
     }
 
-    if (MonoGetExp(&p->arr[p->size - 1]) == 0) {
-        if (PolyIsCoeff(&p->arr[p->size - 1].p)) {
-            // Wyraz wolny zeruje się.
-            if (p->arr[p->size - 1].p.coeff + coeff == 0) {
-                p->size--;
-            }
-                // Dodajemy współczynnik do wielomianu.
-            else {
-                p->arr[p->size - 1].p.coeff += coeff;
-            }
+    // Pusty kawałek czeka na ponowne użycie (zachowujemy największy), chyba że jest bardzo duży.
+    ScratchChunk *chunk = scratch;
+    if (chunk->size > SCRATCH_MAX_KEPT) {
+        scratch = chunk->prev;
+        safeFree(chunk);
+    }
+    else if (chunk->prev != NULL) {
+        scratch = chunk->prev;
+
+        if (scratch_spare != NULL && scratch_spare->size > chunk->size) {
+            safeFree(chunk);
         }
         else {
-            PolyAddCoeff(&p->arr[p->size - 1].p, coeff);
+            safeFree(scratch_spare);
+            scratch_spare = chunk;
         }
     }
-        // Wielomian nie posiada jednomianu o wykładniku 0.
-    else {
-        p->arr[p->size++] = (Mono) {.exp = 0, .p = PolyFromCoeff(coeff)};
-    }
 }
 
 /**
- * Funkcja pomocnicza dla PolyAddMulByScalars.
- * Zakłada, że jeden z wielomianów jest współczynnikiem (coeff)
- * @param[in] p : wielomian
- * @param[in] q : wielomian
- * @param[in] sp : liczba całkowita, skalar @f$ s_p @f$
- * @param[in] sq : liczba całkowita, skalar @f$ s_q @f$
- * @return wielomian @f$ s_pp + s_qq @f$
+ * Internuje tablicę jednomianów wielomianu @p p (w trybie hash-consingu).
+ * Jeśli równa tablica jest już internowana, to wielomian zaczyna z niej korzystać,
+ * a jego tablica jest usuwana.
+ * @param[in,out] p : wielomian
  */
-static Poly PolyAddMulByScalarsHandleCoeff(const Poly *p, const Poly *q, poly_coeff_t sp, poly_coeff_t sq) {
-    assert(PolyCheckIfCorrect(p));
-    assert(PolyCheckIfCorrect(q));
-
-    if (PolyIsCoeff(p) && PolyIsCoeff(q))
-        return PolyFromCoeff((sp * p->coeff) + (sq * q->coeff));
-
-    // dodawanie coeff i wielomianu z arr != NULL
-    Poly result;
+static void PolyIntern(Poly *p) {
+    if (!hash_consing || PolyIsCoeff(p) || MonosGetHeader(p->arr)->interned)
+        return;
 
-    if (PolyIsCoeff(q)) {
-        result = PolyMulByScalar(p, sp);
-        if (PolyIsCoeff(&result))
-            return PolyFromCoeff(result.coeff + sq * q->coeff);
-        PolyAddCoeff(&result, sq * q->coeff);
+    for (size_t i = 0; !MonosIsLeaf(p->arr) && i < p->size; i++) {
+        const Poly *coeff = &MonosCoeffs(p->arr)[i];
+        if (!PolyIsCoeff(coeff) && !MonosGetHeader(coeff->arr)->interned)
+            return;
     }
 
-    if (PolyIsCoeff(p)) {
-        result = PolyMulByScalar(q, sq);
-        if (PolyIsCoeff(&result))
-            return PolyFromCoeff(result.coeff + sp * p->coeff);
-        PolyAddCoeff(&result, sp * p->coeff);
+    size_t hash = MonosHash(p->arr, p->size);
+
+    if (intern_buckets_count > 0) {
+        for (MonosHeader *cur = intern_buckets[hash % intern_buckets_count]; cur != NULL; cur = cur->next) {
+            poly_exp_t *arr = (poly_exp_t*) (cur + 1);
+            if (cur->hash == hash && cur->size == p->size && MonosShallowEq(arr, p->arr, p->size)) {
+                cur->refs++;
+                PolyDestroy(p);
+                p->arr = arr;
+                return;
+            }
+        }
     }
 
-    return result;
+    MonosHeader *header = MonosGetHeader(p->arr);
+    header->size = p->size;
+    header->hash = hash;
+    InternInsert(header);
 }
 
 /**
- * Zwraca sumę wielomianów @p p i @p q przemnożonych
- * odpowiednio przez skalary @f$ s_p @f$ i @f$ s_q @f$.
- * @param[in] p : wielomian
- * @param[in] q : wielomian
- * @param[in] sp : liczba całkowita, skalar @f$ s_p @f$
- * @param[in] sq : liczba całkowita, skalar @f$ s_q @f$
- * @return wielomian @f$ s_pp + s_qq @f$
+ * Zamienia w miejscu tablicę jednomianów o współczynnikach będących liczbami na liść
+ * (liczby są o połowę mniejsze od wielomianów, więc kolejne zapisy nie nadpisują
+ * jeszcze nieprzeczytanych współczynników) i oddaje niepotrzebną pamięć.
+ * @param[in] arr : tablica wykładników zaalokowana przez MonosAlloc
+ * @param[in] size : liczba jednomianów
+ * @return liść
  */
-static Poly PolyAddMulByScalars(const Poly *p, const Poly *q, poly_coeff_t sp, poly_coeff_t sq) {
-    assert(PolyCheckIfCorrect(p));
-    assert(PolyCheckIfCorrect(q));
-
-    // ktorys to wyraz wolny
-    if (PolyIsCoeff(p) || PolyIsCoeff(q))
-        return PolyAddMulByScalarsHandleCoeff(p, q, sp, sq);
+static poly_exp_t* MonosToLeaf(poly_exp_t *arr, size_t size) {
+    const Poly *coeffs = MonosCoeffs(arr);
+    poly_coeff_t *leaf_coeffs = (poly_coeff_t*) coeffs;
 
-    size_t i = 0, ip = 0, iq = 0;
-    Mono *monos_tmp = (Mono*) safeMalloc(sizeof(Mono) * (p->size + q->size + 1));
+    for (size_t i = 0; i < size; i++) {
+        leaf_coeffs[i] = coeffs[i].coeff;
+    }
 
-    while(ip < p->size && iq < q->size) {
-        if (p->arr[ip].exp == q->arr[iq].exp) {
+    MonosHeader *header = MonosGetHeader(arr);
+    header->leaf = true;
+    header = (MonosHeader*) safeRealloc(header, sizeof(MonosHeader) + MonosBytes(header->capacity, true));
+    return (poly_exp_t*) (header + 1);
+}
 
-            // Wykładniki takie same, dodajemy rekurencyjnie współczynniki jednomianów.
-            Mono tmp = (Mono) {.exp = p->arr[ip].exp,
-                    .p = PolyAddMulByScalars(&p->arr[ip].p, &q->arr[iq].p, sp, sq)};
+/**
+ * Tworzy wielomian z tablicy jednomianów zaalokowanej przez MonosAllocKind,
+ * internując ją w trybie hash-consingu. Pustą tablicę i tablicę z samym
+ * wyrazem wolnym będącym liczbą zamienia na współczynnik (niezmiennik 2),
+ * a tablicę o współczynnikach będących liczbami na liść.
+ * @param[in] size : liczba jednomianów
+ * @param[in] arr : tablica wykładników
+ * @return wielomian
+ */
+static Poly PolyFromMonosArr(size_t size, poly_exp_t *arr) {
+    if (size == 0) {
+        MonosFree(arr);
+        return PolyZero();
+    }
 
-            if (!PolyIsZero(&tmp.p))
-                monos_tmp[i++] = tmp;
-            ip++;
-            iq++;
+    // Zachowanie niezmiennika 2).
+    if (size == 1 && arr[0] == 0) {
+        Poly result = MonosCoeffAt(arr, 0);
+        if (PolyIsCoeff(&result)) {
+            MonosFree(arr);
+            return result;
         }
-        else if (p->arr[ip].exp > q->arr[iq].exp) {
-            Mono tmp = MonoMulByScalar(&p->arr[ip], sp);
-            if (!PolyIsZero(&tmp.p))
-                monos_tmp[i++] = tmp;
-            ip++;
+    }
+
+    if (!MonosIsLeaf(arr)) {
+        const Poly *coeffs = MonosCoeffs(arr);
+        size_t i = 0;
+        while (i < size && PolyIsCoeff(&coeffs[i])) {
+            i++;
         }
-        else {
-            Mono tmp = MonoMulByScalar(&q->arr[iq], sq);
-            if (!PolyIsZero(&tmp.p))
-                monos_tmp[i++] = tmp;
-            iq++;
+        if (i == size) {
+            arr = MonosToLeaf(arr, size);
         }
     }
 
-    if (ip == p->size) {
-        while (iq < q->size) {
-            Mono tmp = MonoMulByScalar(&q->arr[iq], sq);
-            if (!PolyIsZero(&tmp.p))
-                monos_tmp[i++] = tmp;
-            iq++;
-        }
+    Poly p = (Poly) {.size = size, .arr = arr};
+    PolyIntern(&p);
+    return p;
+}
+
+/**
+ * Tworzy wielomian z tablicy jednomianów posortowanej malejąco po wykładnikach,
+ * o różnych wykładnikach i niezerowych współczynnikach.
+ * Przejmuje na własność współczynniki jednomianów, ale nie tablicę.
+ * @param[in] size : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @return wielomian
+ */
+static Poly PolyFromSortedMonos(size_t size, const Mono *monos) {
+    poly_exp_t *exps = MonosAlloc(size);
+    Poly *coeffs = MonosCoeffs(exps);
+
+    for (size_t i = 0; i < size; i++) {
+        exps[i] = monos[i].exp;
+        coeffs[i] = monos[i].p;
     }
-    else if (iq == q->size) {
-        while (ip < p->size) {
-            Mono tmp = MonoMulByScalar(&p->arr[ip], sp);
-            if (!PolyIsZero(&tmp.p))
-                monos_tmp[i++] = tmp;
-            ip++;
-        }
+
+    return PolyFromMonosArr(size, exps);
+}
+
+/**
+ * Sprawia, że tablica jednomianów wielomianu @p p nie jest współdzielona,
+ * kopiując ją (płytko, współczynniki są współdzielone) w razie potrzeby.
+ * Kopia ma miejsce na jeden dodatkowy jednomian.
+ * Internowana tablica jest usuwana z tablicy haszującej, bo zaraz zmieni się jej treść.
+ * @param[in,out] p : wielomian
+ */
+static void PolyMakeUnique(Poly *p) {
+    if (PolyIsCoeff(p))
+        return;
+
+    if (MonosGetHeader(p->arr)->refs == 1) {
+        if (MonosGetHeader(p->arr)->interned)
+            InternRemove(MonosGetHeader(p->arr));
+        return;
+    }
+
+    poly_exp_t *arr = MonosAllocKind(p->size + 1, MonosIsLeaf(p->arr));
+    memcpy(arr, p->arr, sizeof(poly_exp_t) * p->size);
+    if (MonosIsLeaf(p->arr)) {
+        memcpy(LeafCoeffs(arr), LeafCoeffs(p->arr), sizeof(poly_coeff_t) * p->size);
+    }
+    else {
+        const Poly *coeffs = MonosCoeffs(p->arr);
+        Poly *coeffs_copy = MonosCoeffs(arr);
+        for (size_t i = 0; i < p->size; i++)
+            coeffs_copy[i] = PolyClone(&coeffs[i]);
+    }
+
+    // Alokacja kopii mogła zwolnić inne odwołania do tablicy (GarbageTake), więc nie wystarczy zmniejszyć licznika.
+    MonosRelease(p->arr, p->size);
+    p->arr = arr;
+}
+
+/**
+ * Asercje czy dany wielomian jest poprawnie reprezentowany.
+ * Sprawdza między innymi niezmiennik 2).
+ * @param[in] p : wielomian
+ * @return bool : sprawdzenie poprawności reprezentacji wielomianu @p p
+ */
+static bool PolyCheckIfCorrect(const Poly *p) {
+    bool result = p != NULL;
+    if (!PolyIsCoeff(p)) {
+        Poly coeff = MonosCoeffAt(p->arr, 0);
+        result = result && !(PolyIsCoeff(&coeff) && p->arr[0] == 0);
+    }
+    return result;
+}
+
+/**
+ * Zwraca większą z dwóch liczb całkowitych.
+ * @param[in] a : liczba całkowita
+ * @param[in] b : liczba całkowita
+ * @return liczba całkowita : @f$\max(a,b)@f$
+ */
+static int max (int a, int b) {
+    if (a >= b)
+        return a;
+
+    return b;
+}
+
+/**
+ * Zwraca @p x podniesione do potęgi @p exp.
+ * @param[in] x : liczba całkowita
+ * @param[in] exp : liczba całkowita, wykładnik
+ * @return liczba całkowita @f$ x^{exp} @f$
+ */
+static poly_coeff_t power (poly_coeff_t x, poly_exp_t exp) {
+
+    poly_coeff_t result = 1;
+
+    while (exp > 0) {
+        if (exp % 2 == 0) {
+            x *= x;
+            exp /= 2;
+        }
+        exp--;
+        result *= x;
+    }
+
+    return result;
+}
+
+/**
+ * Zwraca liść @p p przemnożony przez skalar @p s.
+ * Jedna pętla po wykładnikach i liczbach, zerowe iloczyny są pomijane bez skoków.
+ * @param[in] p : wielomian będący liściem
+ * @param[in] s : liczba całkowita - skalar
+ * @return wielomian @f$sp@f$
+ */
+static Poly LeafMulByScalar(const Poly *p, poly_coeff_t s) {
+    const poly_coeff_t *coeffs = LeafCoeffs(p->arr);
+    poly_exp_t *exps_tmp = LeafAlloc(p->size + 1);
+    poly_coeff_t *coeffs_tmp = LeafCoeffs(exps_tmp);
+
+    size_t size = 0;
+    for (size_t i = 0; i < p->size; i++) {
+        poly_coeff_t coeff = (poly_coeff_t) ((uint64_t) coeffs[i] * (uint64_t) s);
+        exps_tmp[size] = p->arr[i];
+        coeffs_tmp[size] = coeff;
+        size += coeff != 0;
+    }
+
+    return PolyFromMonosArr(size, exps_tmp);
+}
+
+/**
+ * Zwraca sumę liści @p p i @p q przemnożonych odpowiednio przez skalary
+ * @f$ s_p @f$ i @f$ s_q @f$. Scalanie nie ma skoków zależnych od danych
+ * poza warunkiem pętli, wyrazy o zerowej sumie są pomijane.
+ * @param[in] p : wielomian będący liściem
+ * @param[in] q : wielomian będący liściem
+ * @param[in] sp : liczba całkowita, skalar @f$ s_p @f$
+ * @param[in] sq : liczba całkowita, skalar @f$ s_q @f$
+ * @return wielomian @f$ s_pp + s_qq @f$
+ */
+static Poly LeafAddMulByScalars(const Poly *p, const Poly *q, poly_coeff_t sp, poly_coeff_t sq) {
+    const poly_exp_t *exps_p = p->arr, *exps_q = q->arr;
+    const poly_coeff_t *coeffs_p = LeafCoeffs(p->arr), *coeffs_q = LeafCoeffs(q->arr);
+    poly_exp_t *exps_tmp = LeafAlloc(p->size + q->size + 1);
+    poly_coeff_t *coeffs_tmp = LeafCoeffs(exps_tmp);
+    size_t i = 0, ip = 0, iq = 0;
+
+    while (ip < p->size && iq < q->size) {
+        bool take_p = exps_p[ip] >= exps_q[iq];
+        bool take_q = exps_q[iq] >= exps_p[ip];
+        uint64_t coeff = (take_p ? (uint64_t) coeffs_p[ip] * (uint64_t) sp : 0) +
+                         (take_q ? (uint64_t) coeffs_q[iq] * (uint64_t) sq : 0);
+
+        exps_tmp[i] = take_p ? exps_p[ip] : exps_q[iq];
+        coeffs_tmp[i] = (poly_coeff_t) coeff;
+        i += coeff != 0;
+        ip += take_p;
+        iq += take_q;
+    }
+
+    for (; ip < p->size; ip++) {
+        poly_coeff_t coeff = (poly_coeff_t) ((uint64_t) coeffs_p[ip] * (uint64_t) sp);
+        exps_tmp[i] = exps_p[ip];
+        coeffs_tmp[i] = coeff;
+        i += coeff != 0;
+    }
+
+    for (; iq < q->size; iq++) {
+        poly_coeff_t coeff = (poly_coeff_t) ((uint64_t) coeffs_q[iq] * (uint64_t) sq);
+        exps_tmp[i] = exps_q[iq];
+        coeffs_tmp[i] = coeff;
+        i += coeff != 0;
+    }
+
+    return PolyFromMonosArr(i, exps_tmp);
+}
+
+/**
+ * Wylicza wartość liścia w punkcie @p x schematem Hornera po malejących wykładnikach:
+ * @f$ ((c_0 x^{e_0 - e_1} + c_1) x^{e_1 - e_2} + \ldots) x^{e_{n-1}} @f$.
+ * @param[in] p : wielomian będący liściem
+ * @param[in] x : wartość argumentu
+ * @return @f$ p(x) @f$
+ */
+static poly_coeff_t LeafAt(const Poly *p, poly_coeff_t x) {
+    const poly_coeff_t *coeffs = LeafCoeffs(p->arr);
+    uint64_t value = (uint64_t) coeffs[0];
+
+    for (size_t i = 1; i < p->size; i++) {
+        value = value * (uint64_t) power(x, p->arr[i - 1] - p->arr[i]) + (uint64_t) coeffs[i];
+    }
+
+    return (poly_coeff_t) (value * (uint64_t) power(x, p->arr[p->size - 1]));
+}
+
+/**
+ * Zwraca wielomian @p p przemnożony przez skalar @p s.
+ * @param[in] p : wielomian
+ * @param[in] s : liczba całkowita - skalar
+ * @return wielomian @f$sp@f$
+ */
+static Poly PolyMulByScalar(const Poly *p, poly_coeff_t s) {
+    assert(PolyCheckIfCorrect(p));
+
+    if (s == 0) {
+        return PolyZero();
+    }
+
+    if (PolyIsCoeff(p)) {
+        return PolyFromCoeff(s * p->coeff);
+    }
+
+    // Mnożenie przez 1 nie zmienia wielomianu, wystarczy współdzielić tablicę.
+    if (s == 1) {
+        return PolyClone(p);
+    }
+
+    if (MonosIsLeaf(p->arr)) {
+        return LeafMulByScalar(p, s);
+    }
+
+    const Poly *coeffs = MonosCoeffs(p->arr);
+    poly_exp_t *exps_tmp = MonosAlloc(p->size + 1);
+    Poly *coeffs_tmp = MonosCoeffs(exps_tmp);
+
+    size_t size = 0;
+    for (size_t i = 0; i < p->size; i++) {
+        Poly poly_tmp = PolyMulByScalar(&coeffs[i], s);
+        if (!PolyIsZero(&poly_tmp)) {
+            exps_tmp[size] = p->arr[i];
+            coeffs_tmp[size] = poly_tmp;
+            size++;
+        }
+    }
+
+    return PolyFromMonosArr(size, exps_tmp);
+}
+
+/**
+ * Dodaje liczbę całkowitą @p coeff do wielomianu @p p, niebędącego liczbą całkowitą.
+ * Modyfikuje wejściowy wielomian (jego współdzielone tablice są najpierw kopiowane).
+ * @param[in] p : wielomian
+ * @param[in] coeff : liczba całkowita
+ */
+static void PolyAddCoeff (Poly *p, poly_coeff_t coeff) {
+    assert(PolyCheckIfCorrect(p));
+    assert(!PolyIsCoeff(p));
+
+    if (coeff == 0) {
+        return;
+    }
+
+    PolyMakeUnique(p);
+    size_t last = p->size - 1;
+
+    if (p->arr[last] == 0) {
+        poly_coeff_t *free_coeff = NULL;
+        if (MonosIsLeaf(p->arr)) {
+            free_coeff = &LeafCoeffs(p->arr)[last];
+        }
+        else if (PolyIsCoeff(&MonosCoeffs(p->arr)[last])) {
+            free_coeff = &MonosCoeffs(p->arr)[last].coeff;
+        }
+
+        if (free_coeff != NULL) {
+            // Wyraz wolny zeruje się.
+            if (*free_coeff + coeff == 0) {
+                p->size--;
+            }
+                // Dodajemy współczynnik do wielomianu.
+            else {
+                *free_coeff += coeff;
+            }
+        }
+        else {
+            PolyAddCoeff(&MonosCoeffs(p->arr)[last], coeff);
+        }
+    }
+        // Wielomian nie posiada jednomianu o wykładniku 0.
+    else {
+        if (MonosGetHeader(p->arr)->capacity == p->size) {
+            p->arr = MonosGrow(p->arr, p->size, p->size + 1);
+        }
+        p->arr[p->size] = 0;
+        if (MonosIsLeaf(p->arr)) {
+            LeafCoeffs(p->arr)[p->size] = coeff;
+        }
+        else {
+            MonosCoeffs(p->arr)[p->size] = PolyFromCoeff(coeff);
+        }
+        p->size++;
+    }
+
+    PolyIntern(p);
+}
+
+/**
+ * Funkcja pomocnicza dla PolyAddMulByScalars.
+ * Zakłada, że jeden z wielomianów jest współczynnikiem (coeff)
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] sp : liczba całkowita, skalar @f$ s_p @f$
+ * @param[in] sq : liczba całkowita, skalar @f$ s_q @f$
+ * @return wielomian @f$ s_pp + s_qq @f$
+ */
+static Poly PolyAddMulByScalarsHandleCoeff(const Poly *p, const Poly *q, poly_coeff_t sp, poly_coeff_t sq) {
+    assert(PolyCheckIfCorrect(p));
+    assert(PolyCheckIfCorrect(q));
+
+    if (PolyIsCoeff(p) && PolyIsCoeff(q))
+        return PolyFromCoeff((sp * p->coeff) + (sq * q->coeff));
+
+    // dodawanie coeff i wielomianu z arr != NULL
+    Poly result;
+
+    if (PolyIsCoeff(q)) {
+        result = PolyMulByScalar(p, sp);
+        if (PolyIsCoeff(&result))
+            return PolyFromCoeff(result.coeff + sq * q->coeff);
+        PolyAddCoeff(&result, sq * q->coeff);
+    }
+
+    if (PolyIsCoeff(p)) {
+        result = PolyMulByScalar(q, sq);
+        if (PolyIsCoeff(&result))
+            return PolyFromCoeff(result.coeff + sp * p->coeff);
+        PolyAddCoeff(&result, sp * p->coeff);
+    }
+
+    return result;
+}
+
+/**
+ * Zwraca sumę wielomianów @p p i @p q przemnożonych
+ * odpowiednio przez skalary @f$ s_p @f$ i @f$ s_q @f$.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] sp : liczba całkowita, skalar @f$ s_p @f$
+ * @param[in] sq : liczba całkowita, skalar @f$ s_q @f$
+ * @return wielomian @f$ s_pp + s_qq @f$
+ */
+static Poly PolyAddMulByScalars(const Poly *p, const Poly *q, poly_coeff_t sp, poly_coeff_t sq) {
+    assert(PolyCheckIfCorrect(p));
+    assert(PolyCheckIfCorrect(q));
+
+    // ktorys to wyraz wolny
+    if (PolyIsCoeff(p) || PolyIsCoeff(q))
+        return PolyAddMulByScalarsHandleCoeff(p, q, sp, sq);
+
+    if (MonosIsLeaf(p->arr) && MonosIsLeaf(q->arr))
+        return LeafAddMulByScalars(p, q, sp, sq);
+
+    // Scalanie przegląda tylko tablice wykładników, współczynniki czytamy dopiero przy dodawaniu.
+    const poly_exp_t *exps_p = p->arr, *exps_q = q->arr;
+    size_t i = 0, ip = 0, iq = 0;
+    poly_exp_t *exps_tmp = MonosAlloc(p->size + q->size + 1);
+    Poly *coeffs_tmp = MonosCoeffs(exps_tmp);
+
+    while(ip < p->size && iq < q->size) {
+        Poly tmp;
+        poly_exp_t exp;
+
+        if (exps_p[ip] == exps_q[iq]) {
+            // Wykładniki takie same, dodajemy rekurencyjnie współczynniki jednomianów.
+            Poly coeff_p = MonosCoeffAt(p->arr, ip), coeff_q = MonosCoeffAt(q->arr, iq);
+            exp = exps_p[ip++];
+            iq++;
+            tmp = PolyAddMulByScalars(&coeff_p, &coeff_q, sp, sq);
+        }
+        else if (exps_p[ip] > exps_q[iq]) {
+            Poly coeff_p = MonosCoeffAt(p->arr, ip);
+            exp = exps_p[ip++];
+            tmp = PolyMulByScalar(&coeff_p, sp);
+        }
+        else {
+            Poly coeff_q = MonosCoeffAt(q->arr, iq);
+            exp = exps_q[iq++];
+            tmp = PolyMulByScalar(&coeff_q, sq);
+        }
+
+        if (!PolyIsZero(&tmp)) {
+            exps_tmp[i] = exp;
+            coeffs_tmp[i++] = tmp;
+        }
+    }
+
+    for (; ip < p->size; ip++) {
+        Poly coeff_p = MonosCoeffAt(p->arr, ip);
+        Poly tmp = PolyMulByScalar(&coeff_p, sp);
+        if (!PolyIsZero(&tmp)) {
+            exps_tmp[i] = exps_p[ip];
+            coeffs_tmp[i++] = tmp;
+        }
+    }
+
+    for (; iq < q->size; iq++) {
+        Poly coeff_q = MonosCoeffAt(q->arr, iq);
+        Poly tmp = PolyMulByScalar(&coeff_q, sq);
+        if (!PolyIsZero(&tmp)) {
+            exps_tmp[i] = exps_q[iq];
+            coeffs_tmp[i++] = tmp;
+        }
+    }
+
+    return PolyFromMonosArr(i, exps_tmp);
+}
+
+bool PolyIsEq (const Poly *p, const Poly *q) {
+    assert(PolyCheckIfCorrect(p));
+    assert(PolyCheckIfCorrect(q));
+
+    if (PolyIsCoeff(p) || PolyIsCoeff(q)) {
+        if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+            return p->coeff == q->coeff;
+        }
+        else {
+            return false;
+        }
+    }
+
+    if (p->size != q->size)
+        return false;
+
+    // Kopie wielomianu współdzielą tablicę.
+    if (p->arr == q->arr)
+        return true;
+
+    // Różne internowane tablice mają różną treść.
+    if (MonosGetHeader(p->arr)->interned && MonosGetHeader(q->arr)->interned)
+        return false;
+
+    // Liściem jest każda tablica o współczynnikach będących liczbami, więc liść nie jest równy nie-liściowi.
+    if (MonosIsLeaf(p->arr) != MonosIsLeaf(q->arr))
+        return false;
+
+    // Najpierw porównujemy ciągłe tablice wykładników, dopiero potem rekurencyjnie współczynniki.
+    if (memcmp(p->arr, q->arr, sizeof(poly_exp_t) * p->size) != 0)
+        return false;
+
+    if (MonosIsLeaf(p->arr))
+        return memcmp(LeafCoeffs(p->arr), LeafCoeffs(q->arr), sizeof(poly_coeff_t) * p->size) == 0;
+
+    const Poly *coeffs_p = MonosCoeffs(p->arr), *coeffs_q = MonosCoeffs(q->arr);
+    for(size_t i = 0; i < p->size; i++) {
+        if (!PolyIsEq(&coeffs_p[i], &coeffs_q[i]))
+            return false;
+    }
+
+    return true;
+}
+
+poly_exp_t PolyDeg(const Poly *p) {
+    assert(PolyCheckIfCorrect(p));
+
+    if (PolyIsZero(p)) {
+        return -1;
+    }
+
+    if(PolyIsCoeff(p)) {
+        return 0;
+    }
+
+    // Wykładniki są posortowane malejąco, a współczynniki liścia są liczbami.
+    if (MonosIsLeaf(p->arr)) {
+        return p->arr[0];
+    }
+
+    const Poly *coeffs = MonosCoeffs(p->arr);
+    poly_exp_t deg_max = 0;
+
+    for (size_t i = 0; i < p->size; i++) {
+        poly_exp_t tmp = p->arr[i] + PolyDeg(&coeffs[i]);
+        deg_max = max(deg_max, tmp);
+    }
+
+    return deg_max;
+}
+
+Poly PolyAdd(const Poly *p, const Poly *q) {
+    assert(PolyCheckIfCorrect(p));
+    assert(PolyCheckIfCorrect(q));
+    return PolyAddMulByScalars(p, q, 1, 1);
+}
+
+/**
+ * Największa liczba jednomianów sortowanych przez wstawianie (większe tablice sortuje MonosRadixSort).
+ */
+#define MONOS_INSERTION_SORT_MAX 32
+
+/**
+ * Liczba bitów cyfry sortowania pozycyjnego jednomianów.
+ */
+#define MONOS_RADIX_BITS 8
+
+/**
+ * Daje klucz sortowania jednomianu: klucze rosną, gdy wykładniki maleją.
+ * @param[in] m : jednomian o nieujemnym wykładniku
+ * @return klucz
+ */
+static uint32_t MonoSortKey(const Mono *m) {
+    assert(m->exp >= 0);
+    return (uint32_t) INT_MAX - (uint32_t) m->exp;
+}
+
+/**
+ * Sortuje stabilnie jednomiany malejąco po wykładnikach, pozycyjnie (LSD)
+ * po cyfrach klucza MonoSortKey. Cyfry, które są takie same we wszystkich
+ * kluczach (np. starsze cyfry małych wykładników), nie wymagają przebiegu.
+ * @param[in] count : liczba jednomianów
+ * @param[in,out] monos : tablica jednomianów
+ */
+static void MonosRadixSort(size_t count, Mono *monos) {
+    Mono *tmp = (Mono*) ScratchAlloc(sizeof(Mono) * count);
+    Mono *src = monos, *dst = tmp;
+
+    for (unsigned shift = 0; shift < 32; shift += MONOS_RADIX_BITS) {
+        size_t counts[1 << MONOS_RADIX_BITS] = {0};
+        for (size_t i = 0; i < count; i++) {
+            counts[(MonoSortKey(&src[i]) >> shift) & ((1 << MONOS_RADIX_BITS) - 1)]++;
+        }
+
+        if (counts[(MonoSortKey(&src[0]) >> shift) & ((1 << MONOS_RADIX_BITS) - 1)] == count) {
+            continue;
+        }
+
+        size_t pos = 0;
+        for (size_t digit = 0; digit < (1 << MONOS_RADIX_BITS); digit++) {
+            size_t digit_count = counts[digit];
+            counts[digit] = pos;
+            pos += digit_count;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            dst[counts[(MonoSortKey(&src[i]) >> shift) & ((1 << MONOS_RADIX_BITS) - 1)]++] = src[i];
+        }
+
+        Mono *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != monos) {
+        memcpy(monos, src, sizeof(Mono) * count);
+    }
+    ScratchFree(tmp);
+}
+
+/**
+ * Sortuje jednomiany malejąco po wykładnikach: krótkie tablice przez wstawianie,
+ * dłuższe pozycyjnie (MonosRadixSort).
+ * @param[in] count : liczba jednomianów
+ * @param[in,out] monos : tablica jednomianów
+ */
+static void MonosSortByExp(size_t count, Mono *monos) {
+    if (count > MONOS_INSERTION_SORT_MAX) {
+        MonosRadixSort(count, monos);
+        return;
+    }
+
+    for (size_t i = 1; i < count; i++) {
+        Mono cur = monos[i];
+        size_t j = i;
+        while (j > 0 && monos[j - 1].exp < cur.exp) {
+            monos[j] = monos[j - 1];
+            j--;
+        }
+        monos[j] = cur;
+    }
+}
+
+/**
+ * Wspólne jądro PolyAddMonos, PolyOwnMonos i PolyCloneMonos: sortuje jednomiany raz,
+ * a potem w jednym przebiegu sumuje ciągi jednomianów o równych wykładnikach
+ * (liczby wprost, wielomiany w miejscu, w tablicy pierwszego z nich przez PolyAddOwn)
+ * i zagęszcza tablicę, pomijając zerowe sumy.
+ * Przejmuje na własność współczynniki jednomianów, ale nie tablicę.
+ * @param[in] count : liczba jednomianów
+ * @param[in,out] monos : tablica jednomianów
+ * @return wielomian będący sumą jednomianów
+ */
+static Poly MonosSortAndSum(size_t count, Mono *monos) {
+    MonosSortByExp(count, monos);
+
+    size_t size = 0;
+    for (size_t i = 0; i < count;) {
+        poly_exp_t exp = monos[i].exp;
+        Poly sum = monos[i++].p;
+
+        for (; i < count && monos[i].exp == exp; i++) {
+            if (PolyIsCoeff(&sum) && PolyIsCoeff(&monos[i].p)) {
+                sum.coeff += monos[i].p.coeff;
+            }
+            else {
+                sum = PolyAddOwn(&sum, &monos[i].p);
+            }
+        }
+
+        if (!PolyIsZero(&sum)) {
+            monos[size++] = (Mono) {.p = sum, .exp = exp};
+        }
+    }
+
+    if (size == 0) {
+        return PolyZero();
+    }
+
+    return PolyFromSortedMonos(size, monos);
+}
+
+Poly PolyAddMonos(size_t count, const Mono monos[]) {
+
+    if (count == 0) {
+        return PolyZero();
+    }
+
+    // Przepisywanie wejściowej tablicy.
+    Mono *monos_tmp = (Mono*) ScratchAlloc(sizeof(Mono) * count);
+    memcpy(monos_tmp, monos, sizeof(Mono) * count);
+
+    Poly result = MonosSortAndSum(count, monos_tmp);
+    ScratchFree(monos_tmp);
+    return result;
+}
+
+void PolyDestroy(Poly *p) {
+    PolyCheckIfCorrect(p);
+
+    if (PolyIsCoeff(p)){
+        return;
+    }
+
+    // Usunięcie całego drzewa zajmuje stały czas: współczynniki tablicy są zwalniane
+    // później, przy kolejnych alokacjach (GarbageTake), a jej pamięć zwykle użyta ponownie.
+    MonosRelease(p->arr, p->size);
+}
+
+void PolyFreeCaches(void) {
+    while (garbage != NULL) {
+        safeFree(GarbagePop());
+    }
+
+    if (scratch != NULL && scratch->used == 0) {
+        safeFree(scratch);
+        scratch = NULL;
+    }
+    safeFree(scratch_spare);
+    scratch_spare = NULL;
+}
+
+Poly PolyClone(const Poly *p) {
+    assert(PolyCheckIfCorrect(p));
+
+    if (!PolyIsCoeff(p)) {
+        MonosGetHeader(p->arr)->refs++;
+    }
+
+    return *p;
+}
+
+Poly PolyNeg(const Poly *p) {
+    assert(PolyCheckIfCorrect(p));
+    return PolyMulByScalar(p, -1);
+}
+
+Poly PolySub(const Poly *p, const Poly *q) {
+    assert(PolyCheckIfCorrect(p));
+    assert(PolyCheckIfCorrect(q));
+    return PolyAddMulByScalars(p, q, 1, -1);
+}
+
+poly_exp_t PolyDegBy(const Poly *p, size_t var_idx) {
+    assert(PolyCheckIfCorrect(p));
+
+    if (PolyIsZero(p)) {
+        return -1;
+    }
+
+    if (PolyIsCoeff(p)) {
+        return 0;
+    }
+
+    // Wykładniki są posortowane malejąco (niezmiennik 1).
+    if (var_idx == 0) {
+        return p->arr[0];
+    }
+
+    // Niezerowe liczby są stopnia 0 względem każdej zmiennej.
+    if (MonosIsLeaf(p->arr)) {
+        return 0;
+    }
+
+    const Poly *coeffs = MonosCoeffs(p->arr);
+    poly_exp_t result = -1;
+    for (size_t i = 0; i < p->size; i++) {
+        result = max(result, PolyDegBy(&coeffs[i], var_idx - 1));
+    }
+    return result;
+}
+
+Poly PolyAt (const Poly *p, poly_coeff_t x) {
+    assert(PolyCheckIfCorrect(p));
+
+    if (PolyIsCoeff(p)) {
+        return PolyFromCoeff(p->coeff);
+    }
+
+    if (MonosIsLeaf(p->arr)) {
+        return PolyFromCoeff(LeafAt(p, x));
+    }
+
+    // Wielomian wynikowy, który będziemy nadpisywać
+    // dodając do niego kolejne wielomiany przemnożone
+    // przez odpowiedni skalar.
+    Poly result = PolyZero();
+    const Poly *coeffs = MonosCoeffs(p->arr);
+
+    for (size_t i = 0; i < p->size; i++) {
+        poly_coeff_t s = power(x, p->arr[i]);
+        if (s == 0) {
+            continue;
+        }
+        Poly tmp = PolyAddMulByScalars(&result, &coeffs[i], 1, s);
+
+        PolyDestroy(&result);
+        result = tmp;
+    }
+
+    return result;
+}
+
+Mono PolyGetMono(const Poly *p, size_t i) {
+    assert(!PolyIsCoeff(p) && i < p->size);
+    return (Mono) {.p = MonosCoeffAt(p->arr, i), .exp = p->arr[i]};
+}
+
+/**
+ * Sprawdza, czy wielomian ma tablicę jednomianów, z której nie korzysta nikt inny.
+ * @param[in] p : wielomian
+ * @return Czy tablicę @p p można zmieniać w miejscu?
+ */
+static bool PolyIsUnique(const Poly *p) {
+    return !PolyIsCoeff(p) && MonosGetHeader(p->arr)->refs == 1;
+}
+
+/**
+ * Daje współczynnik jednomianu na własność: zabiera go z tablicy, którą zaraz zwolnimy
+ * bez zawartości (MonosFree), albo robi jego kopię.
+ * @param[in] arr : tablica wykładników
+ * @param[in] i : indeks jednomianu
+ * @param[in] own : czy współczynniki tablicy są nasze?
+ * @return współczynnik
+ */
+static Poly MonosCoeffTake(const poly_exp_t *arr, size_t i, bool own) {
+    Poly coeff = MonosCoeffAt(arr, i);
+    return own ? coeff : PolyClone(&coeff);
+}
+
+/**
+ * Zwraca wielomian @p p przemnożony przez skalar @p s, przejmując @p p na własność.
+ * Nie współdzieloną tablicę mnoży w miejscu, pomijając zerowe iloczyny.
+ * @param[in] p : wielomian
+ * @param[in] s : liczba całkowita - skalar
+ * @return wielomian @f$sp@f$
+ */
+static Poly PolyMulByScalarOwn(Poly *p, poly_coeff_t s) {
+    assert(PolyCheckIfCorrect(p));
+
+    if (PolyIsCoeff(p)) {
+        return PolyFromCoeff(s * p->coeff);
+    }
+
+    if (s == 1) {
+        return *p;
+    }
+
+    if (s == 0 || !PolyIsUnique(p)) {
+        Poly result = PolyMulByScalar(p, s);
+        PolyDestroy(p);
+        return result;
+    }
+
+    PolyMakeUnique(p);
+    poly_exp_t *exps = p->arr;
+    size_t size = 0;
+
+    if (MonosIsLeaf(exps)) {
+        poly_coeff_t *coeffs = LeafCoeffs(exps);
+        for (size_t i = 0; i < p->size; i++) {
+            poly_coeff_t coeff = (poly_coeff_t) ((uint64_t) coeffs[i] * (uint64_t) s);
+            exps[size] = exps[i];
+            coeffs[size] = coeff;
+            size += coeff != 0;
+        }
+    }
+    else {
+        Poly *coeffs = MonosCoeffs(exps);
+        for (size_t i = 0; i < p->size; i++) {
+            Poly coeff = PolyMulByScalarOwn(&coeffs[i], s);
+            if (!PolyIsZero(&coeff)) {
+                exps[size] = exps[i];
+                coeffs[size++] = coeff;
+            }
+        }
+    }
+
+    return PolyFromMonosArr(size, exps);
+}
+
+/**
+ * Scala w miejscu liść @p q z liściem @p p, którego tablica nie jest współdzielona
+ * i ma miejsce na jednomiany obu liści. Jednomiany @p p są najpierw przesuwane
+ * na koniec tablicy, więc zapis nigdy nie wyprzedza odczytu.
+ * @param[in,out] p : wielomian będący liściem
+ * @param[in] q : wielomian będący liściem
+ * @return liczba jednomianów wyniku
+ */
+static size_t LeafMergeInto(Poly *p, const Poly *q) {
+    poly_exp_t *exps = p->arr;
+    poly_coeff_t *coeffs = LeafCoeffs(exps);
+    const poly_coeff_t *coeffs_q = LeafCoeffs(q->arr);
+    size_t ip = q->size, end = q->size + p->size, iq = 0, i = 0;
+
+    memmove(exps + q->size, exps, sizeof(poly_exp_t) * p->size);
+    memmove(coeffs + q->size, coeffs, sizeof(poly_coeff_t) * p->size);
+
+    while (ip < end && iq < q->size) {
+        bool take_p = exps[ip] >= q->arr[iq];
+        bool take_q = q->arr[iq] >= exps[ip];
+        uint64_t coeff = (take_p ? (uint64_t) coeffs[ip] : 0) + (take_q ? (uint64_t) coeffs_q[iq] : 0);
+
+        exps[i] = take_p ? exps[ip] : q->arr[iq];
+        coeffs[i] = (poly_coeff_t) coeff;
+        i += coeff != 0;
+        ip += take_p;
+        iq += take_q;
+    }
+
+    for (; ip < end; ip++, i++) {
+        exps[i] = exps[ip];
+        coeffs[i] = coeffs[ip];
+    }
+
+    for (; iq < q->size; iq++, i++) {
+        exps[i] = q->arr[iq];
+        coeffs[i] = coeffs_q[iq];
+    }
+
+    return i;
+}
+
+/**
+ * Scala w miejscu wielomian @p q z wielomianem @p p niebędącym liściem, którego tablica
+ * nie jest współdzielona i ma miejsce na jednomiany obu wielomianów (jak LeafMergeInto).
+ * Współczynniki o równych wykładnikach są dodawane rekurencyjnie przez PolyAddOwn.
+ * @param[in,out] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] own : czy współczynniki @p q są nasze?
+ * @return liczba jednomianów wyniku
+ */
+static size_t MonosMergeInto(Poly *p, const Poly *q, bool own) {
+    poly_exp_t *exps = p->arr;
+    Poly *coeffs = MonosCoeffs(exps);
+    size_t ip = q->size, end = q->size + p->size, iq = 0, i = 0;
+
+    memmove(exps + q->size, exps, sizeof(poly_exp_t) * p->size);
+    memmove(coeffs + q->size, coeffs, sizeof(Poly) * p->size);
+
+    while (ip < end || iq < q->size) {
+        Poly coeff;
+        poly_exp_t exp;
+
+        if (iq == q->size || (ip < end && exps[ip] > q->arr[iq])) {
+            exp = exps[ip];
+            coeff = coeffs[ip++];
+        }
+        else if (ip == end || exps[ip] < q->arr[iq]) {
+            exp = q->arr[iq];
+            coeff = MonosCoeffTake(q->arr, iq++, own);
+        }
+        else {
+            Poly coeff_q = MonosCoeffTake(q->arr, iq++, own);
+            exp = exps[ip];
+            coeff = PolyAddOwn(&coeffs[ip++], &coeff_q);
+        }
+
+        if (!PolyIsZero(&coeff)) {
+            exps[i] = exp;
+            coeffs[i++] = coeff;
+        }
+    }
+
+    return i;
+}
+
+/**
+ * Sprawdza, czy w tablicy wielomianu @p p można w miejscu policzyć sumę z @p q.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return Czy tablica @p p nie jest współdzielona i pomieści współczynniki @p q?
+ */
+static bool PolyCanMergeInto(const Poly *p, const Poly *q) {
+    return PolyIsUnique(p) && (!MonosIsLeaf(p->arr) || MonosIsLeaf(q->arr));
+}
+
+Poly PolyAddOwn(Poly *p, Poly *q) {
+    assert(PolyCheckIfCorrect(p));
+    assert(PolyCheckIfCorrect(q));
+
+    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+        return PolyFromCoeff(p->coeff + q->coeff);
+    }
+
+    if (PolyIsCoeff(p)) {
+        Poly *tmp = p;
+        p = q;
+        q = tmp;
+    }
+
+    if (PolyIsCoeff(q)) {
+        PolyAddCoeff(p, q->coeff);
+        return *p;
+    }
+
+    // Wynik powstaje w tablicy większego wielomianu, o ile można ją zmieniać.
+    if (!PolyCanMergeInto(p, q) || (PolyCanMergeInto(q, p) && q->size > p->size)) {
+        Poly *tmp = p;
+        p = q;
+        q = tmp;
+    }
+
+    if (!PolyCanMergeInto(p, q)) {
+        Poly result = PolyAdd(p, q);
+        PolyDestroy(p);
+        PolyDestroy(q);
+        return result;
+    }
+
+    PolyMakeUnique(p);
+    bool own = PolyIsUnique(q);
+    if (own) {
+        PolyMakeUnique(q);
+    }
+
+    // Tablica rośnie geometrycznie, bo sumy często powstają przez kolejne dodawanie do jednego wielomianu.
+    size_t capacity = MonosGetHeader(p->arr)->capacity;
+    if (capacity < p->size + q->size) {
+        p->arr = MonosGrow(p->arr, p->size, p->size + q->size > 2 * capacity ? p->size + q->size : 2 * capacity);
+    }
+
+    size_t size = MonosIsLeaf(p->arr) ? LeafMergeInto(p, q) : MonosMergeInto(p, q, own);
+
+    // Współczynniki q trafiły do wyniku albo zostały skopiowane.
+    if (own) {
+        MonosFree(q->arr);
+    }
+    else {
+        PolyDestroy(q);
     }
 
-    if (i == 0) {
-        free(monos_tmp);
-        return PolyZero();
+    return PolyFromMonosArr(size, p->arr);
+}
+
+Poly PolySubOwn(Poly *p, Poly *q) {
+    Poly neg = PolyNegOwn(q);
+    return PolyAddOwn(p, &neg);
+}
+
+Poly PolyMulOwn(Poly *p, Poly *q) {
+    if (PolyIsCoeff(p)) {
+        return PolyMulByScalarOwn(q, p->coeff);
     }
 
-    // Zachowywanie niezmiennika 2).
-    if (i == 1 && PolyIsCoeff(&monos_tmp[0].p) && MonoGetExp(&monos_tmp[0]) == 0) {
-        Poly result = PolyFromCoeff(monos_tmp[0].p.coeff);
-        free(monos_tmp);
-        return result;
+    if (PolyIsCoeff(q)) {
+        return PolyMulByScalarOwn(p, q->coeff);
     }
 
-    return (Poly) {.size = i, .arr = monos_tmp};
+    Poly result = PolyMul(p, q);
+    PolyDestroy(p);
+    PolyDestroy(q);
+    return result;
 }
 
-/**
- * Sprawdza równość dwóch jednomianów.
- * @param[in] m : jednomian @f$p@f$
- * @param[in] n : jednomian @f$q@f$
- * @return @f$m = n@f$
- */
-static bool MonoIsEq (const Mono *m, const Mono *n) {
-    return m->exp == n->exp && PolyIsEq(&m->p, &n->p);
+Poly PolyNegOwn(Poly *p) {
+    return PolyMulByScalarOwn(p, -1);
 }
 
-bool PolyIsEq (const Poly *p, const Poly *q) {
+Poly PolyAtOwn(Poly *p, poly_coeff_t x) {
     assert(PolyCheckIfCorrect(p));
-    assert(PolyCheckIfCorrect(q));
 
-    if (PolyIsCoeff(p) || PolyIsCoeff(q)) {
-        if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
-            return p->coeff == q->coeff;
-        }
-        else {
-            return false;
-        }
+    if (PolyIsCoeff(p)) {
+        return *p;
     }
 
-    if (p->size != q->size)
-        return false;
+    if (MonosIsLeaf(p->arr)) {
+        Poly result = PolyFromCoeff(LeafAt(p, x));
+        PolyDestroy(p);
+        return result;
+    }
 
-    for(size_t i = 0; i < p->size; i++) {
-        if (!MonoIsEq(&p->arr[i], &q->arr[i]))
-            return false;
+    bool own = PolyIsUnique(p);
+    if (own) {
+        PolyMakeUnique(p);
     }
 
-    return true;
-}
+    // Wynik rośnie w miejscu, w tablicy największego ze składników.
+    Poly result = PolyZero();
+    Poly *coeffs = MonosCoeffs(p->arr);
+
+    for (size_t i = 0; i < p->size; i++) {
+        poly_coeff_t s = power(x, p->arr[i]);
+        if (s == 0) {
+            if (own) {
+                PolyDestroy(&coeffs[i]);
+            }
+            continue;
+        }
 
-void* safeMalloc (size_t size) {
-    void *p = malloc (size);
+        Poly coeff = MonosCoeffTake(p->arr, i, own);
+        Poly scaled = PolyMulByScalarOwn(&coeff, s);
+        result = PolyAddOwn(&result, &scaled);
+    }
 
-    if (size > 0 && p == NULL) {
-        exit(EXIT_FAILURE);
+    if (own) {
+        MonosFree(p->arr);
+    }
+    else {
+        PolyDestroy(p);
     }
 
-    return p;
+    return result;
 }
 
-void* safeRealloc (void *ptr, size_t size) {
-    void *p = realloc (ptr, size);
+/**
+ * Minimalna liczba wyrazów (liczb w liściach drzewa) każdego z czynników,
+ * od której opłaca się mnożenie w postaci gęstej.
+ */
+#define DENSE_MIN_SIZE 16
 
-    if(size > 0 && p == NULL)
-        exit(EXIT_FAILURE);
+/**
+ * Czynnik jest gęsty, jeśli jego stopień po podstawieniu Kroneckera + 1
+ * jest co najwyżej tyle razy większy od liczby wyrazów.
+ */
+#define DENSE_MAX_SPARSITY 2
 
-    return p;
+/**
+ * Liczy liczbę zmiennych, liczbę wyrazów, liczbę jednomianów (we wszystkich warstwach)
+ * i największy wykładnik wielomianu.
+ * @param[in] p : wielomian
+ * @param[in] var : indeks zmiennej warstwy @p p
+ * @param[in,out] vars : największa dotąd liczba zmiennych
+ * @param[in,out] terms : liczba wyrazów dotąd
+ * @param[in,out] monos : liczba jednomianów dotąd
+ * @param[in,out] max_exp : największy dotąd wykładnik
+ */
+static void PolyShape(const Poly *p, size_t var, size_t *vars, size_t *terms, size_t *monos, poly_exp_t *max_exp) {
+    if (PolyIsCoeff(p)) {
+        (*terms)++;
+        if (var > *vars) {
+            *vars = var;
+        }
+        return;
+    }
+
+    *monos += p->size;
+    for (size_t i = 0; i < p->size; i++) {
+        Poly coeff = MonosCoeffAt(p->arr, i);
+        *max_exp = max(*max_exp, p->arr[i]);
+        PolyShape(&coeff, var + 1, vars, terms, monos, max_exp);
+    }
 }
 
-poly_exp_t PolyDeg(const Poly *p) {
-    assert(PolyCheckIfCorrect(p));
+/**
+ * Zapisuje wielomian w postaci gęstej po podstawieniu Kroneckera
+ * @f$ x_i = x^{s_i} @f$, gdzie @f$ s_i @f$ to kolejne krotności.
+ * @param[in] p : wielomian
+ * @param[in] offset : wykładnik @f$ x @f$ wnoszony przez wcześniejsze zmienne
+ * @param[in] var : indeks zmiennej warstwy @p p
+ * @param[in] strides : krotności @f$ s_i @f$
+ * @param[out] dense : wyzerowana tablica współczynników
+ */
+static void PolyPack(const Poly *p, size_t offset, size_t var, const size_t *strides, dense_coeff_t *dense) {
+    if (PolyIsCoeff(p)) {
+        dense[offset] = (dense_coeff_t) p->coeff;
+        return;
+    }
 
-    if (PolyIsZero(p)) {
-        return -1;
+    for (size_t i = 0; i < p->size; i++) {
+        Poly coeff = MonosCoeffAt(p->arr, i);
+        PolyPack(&coeff, offset + (size_t) p->arr[i] * strides[var], var + 1, strides, dense);
     }
+}
 
-    if(PolyIsCoeff(p)) {
-        return 0;
+/**
+ * Odtwarza wielomian zmiennych o indeksach od @p var z postaci gęstej po podstawieniu Kroneckera.
+ * @param[in] dense : tablica współczynników
+ * @param[in] len : liczba współczynników
+ * @param[in] offset : wykładnik @f$ x @f$ wnoszony przez wcześniejsze zmienne, mniejszy od @p len
+ * @param[in] var : indeks zmiennej
+ * @param[in] vars : liczba zmiennych
+ * @param[in] strides : krotności @f$ s_i @f$
+ * @param[in] bases : ograniczenia wykładników, @f$ s_{i+1} = s_i b_i @f$
+ * @return wielomian
+ */
+static Poly PolyUnpack(const dense_coeff_t *dense, size_t len, size_t offset, size_t var, size_t vars,
+                       const size_t *strides, const size_t *bases) {
+    if (var == vars) {
+        return PolyFromCoeff((poly_coeff_t) dense[offset]);
     }
 
-    poly_exp_t deg_max = 0;
+    // Wykładniki, dla których nie wychodzimy poza tablicę.
+    size_t count = (len - offset - 1) / strides[var] + 1;
+    if (count > bases[var]) {
+        count = bases[var];
+    }
 
-    for (size_t i = 0; i < p->size; i++) {
-        poly_exp_t tmp = MonoGetExp(&p->arr[i]) + PolyDeg(&(p->arr[i].p));
-        deg_max = max(deg_max, tmp);
+    poly_exp_t *exps = MonosAlloc(count);
+    Poly *coeffs = MonosCoeffs(exps);
+    size_t size = 0;
+    for (size_t e = count; e-- > 0;) {
+        Poly coeff = PolyUnpack(dense, len, offset + e * strides[var], var + 1, vars, strides, bases);
+        if (!PolyIsZero(&coeff)) {
+            exps[size] = (poly_exp_t) e;
+            coeffs[size++] = coeff;
+        }
     }
 
-    return deg_max;
+    return PolyFromMonosArr(size, exps);
 }
 
-Poly PolyAdd(const Poly *p, const Poly *q) {
-    assert(PolyCheckIfCorrect(p));
-    assert(PolyCheckIfCorrect(q));
-    return PolyAddMulByScalars(p, q, 1, 1);
-}
+/**
+ * Mnoży wielomiany przez podstawienie Kroneckera: dla @f$ b_i = \deg_i p + \deg_i q + 1 @f$
+ * podstawia @f$ x_i = x^{b_0 b_1 \ldots b_{i-1}} @f$, mnoży wielomiany jednej zmiennej
+ * w postaci gęstej (DenseMul) i rozkłada wynik z powrotem (wykładniki wyniku nie przekraczają
+ * @f$ b_i @f$, więc się nie mieszają). Robi to tylko wtedy, gdy oba czynniki po podstawieniu
+ * są gęste (zob. DENSE_MIN_SIZE, DENSE_MAX_SPARSITY).
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @param[in] q : wielomian niebędący współczynnikiem
+ * @param[in] vars : liczba zmiennych @p p i @p q
+ * @param[in] terms_p : liczba wyrazów @p p
+ * @param[in] terms_q : liczba wyrazów @p q
+ * @param[out] result : @f$ p * q @f$
+ * @return Czy wielomiany zostały pomnożone?
+ */
+static bool PolyMulKronecker(const Poly *p, const Poly *q, size_t vars, size_t terms_p, size_t terms_q,
+                             Poly *result) {
+    if (terms_p < DENSE_MIN_SIZE || terms_q < DENSE_MIN_SIZE) {
+        return false;
+    }
 
-Poly PolyAddMonos(size_t count, const Mono monos[]) {
+    size_t *strides = (size_t*) ScratchAlloc(sizeof(size_t) * 2 * vars);
+    size_t *bases = strides + vars;
+    // Długości czynników po podstawieniu.
+    size_t n = 1, m = 1;
+    size_t stride = 1;
+    bool dense = true;
+
+    for (size_t var = 0; var < vars && dense; var++) {
+        size_t deg_p = (size_t) PolyDegBy(p, var);
+        size_t deg_q = (size_t) PolyDegBy(q, var);
+
+        strides[var] = stride;
+        bases[var] = deg_p + deg_q + 1;
+
+        // Czynniki nie są gęste albo wykładniki nie mieszczą się w size_t.
+        if ((deg_p > 0 && stride > (DENSE_MAX_SPARSITY * terms_p - n) / deg_p) ||
+            (deg_q > 0 && stride > (DENSE_MAX_SPARSITY * terms_q - m) / deg_q) ||
+            (var + 1 < vars && stride > SIZE_MAX / bases[var])) {
+            dense = false;
+            break;
+        }
 
-    if (count == 0) {
-        return PolyZero();
+        n += deg_p * stride;
+        m += deg_q * stride;
+        stride *= bases[var];
     }
 
-    // Przepisywanie wejściowej tablicy.
-    Mono *monos_tmp = (Mono*) safeMalloc (sizeof(Mono) * (count + 1));
-    for (size_t i = 0; i < count; i++) {
-        monos_tmp[i] = monos[i];
+    if (dense) {
+        dense_coeff_t *a = (dense_coeff_t*) ScratchAlloc(sizeof(dense_coeff_t) * n);
+        dense_coeff_t *b = (dense_coeff_t*) ScratchAlloc(sizeof(dense_coeff_t) * m);
+        dense_coeff_t *product = (dense_coeff_t*) ScratchAlloc(sizeof(dense_coeff_t) * (n + m - 1));
+        memset(a, 0, sizeof(dense_coeff_t) * n);
+        memset(b, 0, sizeof(dense_coeff_t) * m);
+
+        PolyPack(p, 0, 0, strides, a);
+        PolyPack(q, 0, 0, strides, b);
+        DenseMul(a, n, b, m, product);
+        *result = PolyUnpack(product, n + m - 1, 0, 0, vars, strides, bases);
+
+        ScratchFree(product);
+        ScratchFree(b);
+        ScratchFree(a);
     }
-    // Placeholder, dzięki temu nie martwimy się o wyjście poza zakres tablicy.
-    monos_tmp[count] = (Mono) {.exp = INT_MIN};
-    // Sortowanie tablicy jednomianów malejąco po wykładniku.
-    qsort(monos_tmp, count + 1, sizeof(Mono), monoCmp);
-
-    size_t size = count;
-    for (size_t i = 0; i < count; i++) {
-        assert (monos_tmp[i].exp >= monos_tmp[i + 1].exp);
-        Mono cur = monos_tmp[i];
-        Mono next = monos_tmp[i + 1];
-
-        // Jeśli aktualny wielomian jest zerem, to oznaczamy go flagą (exp = INT_MIN).
-        // Dzięki temu, przy następnym sortowaniu, znajdzie się on
-        // za poprawnymi jednomianami.
-        if (PolyIsZero(&cur.p)) {
-            monos_tmp[i].exp = INT_MIN;
-            size--;
-        }
-            // Dodajemy sąsiadów o tym samym wykładniku.
-        else if (MonoGetExp(&cur) == MonoGetExp(&next)) {
-            Mono tmp = next;
-            monos_tmp[i + 1].p = PolyAdd(&cur.p, &tmp.p);
-            monos_tmp[i].exp = INT_MIN;
 
-            PolyDestroy(&cur.p);
-            PolyDestroy(&tmp.p);
+    ScratchFree(strides);
+    return dense;
+}
 
-            size--;
+/**
+ * Dopisuje wyrazy wielomianu do wielomianu płaskiego.
+ * @param[in] p : wielomian
+ * @param[in] var : indeks zmiennej warstwy @p p
+ * @param[in,out] exps : wykładniki zmiennych wcześniejszych warstw
+ * @param[in,out] f : wielomian płaski
+ */
+static void PolyPushToFlat(const Poly *p, size_t var, poly_exp_t *exps, FlatPoly *f) {
+    if (PolyIsCoeff(p)) {
+        if (!PolyIsZero(p)) {
+            for (size_t i = var; i < f->vars; i++) {
+                exps[i] = 0;
+            }
+            FlatPush(f, exps, p->coeff);
         }
+        return;
     }
 
-    if (size == 0) {
-        free(monos_tmp);
-        return PolyZero();
+    for (size_t i = 0; i < p->size; i++) {
+        Poly coeff = MonosCoeffAt(p->arr, i);
+        exps[var] = p->arr[i];
+        PolyPushToFlat(&coeff, var + 1, exps, f);
     }
+}
 
-    // Drugie sortowanie, wyzerowane jednomiany (exp = -1) trafiają na koniec tablicy.
-    qsort(monos_tmp, count + 1, sizeof(Mono), monoCmp);
+FlatPoly PolyToFlat(const Poly *p) {
+    size_t vars = 0, terms = 0, monos = 0;
+    poly_exp_t max_exp = 0;
+    PolyShape(p, 0, &vars, &terms, &monos, &max_exp);
 
-    // Zachowanie niezmiennika 2).
-    if (size == 1 && PolyIsCoeff(&monos_tmp[0].p) && MonoGetExp(&monos_tmp[0]) == 0) {
-        Poly result = PolyFromCoeff(monos_tmp[0].p.coeff);
-        free(monos_tmp);
-        return result;
-    }
+    FlatPoly f = FlatCreate(vars, FlatBits((uint64_t) max_exp), terms);
+    poly_exp_t *exps = (poly_exp_t*) ScratchAlloc(sizeof(poly_exp_t) * (vars + 1));
+    PolyPushToFlat(p, 0, exps, &f);
+    ScratchFree(exps);
 
-    return (Poly) {.size = size, .arr = monos_tmp};
+    return f;
 }
 
-void PolyDestroy(Poly *p) {
-    PolyCheckIfCorrect(p);
-
-    if (PolyIsCoeff(p)){
-        return;
+/**
+ * Tworzy wielomian zmiennych o indeksach od @p var z wyrazów wielomianu płaskiego
+ * o indeksach od @p begin do @p end - 1 (mających te same wykładniki wcześniejszych zmiennych).
+ * @param[in] f : wielomian płaski
+ * @param[in] begin : indeks pierwszego wyrazu
+ * @param[in] end : indeks za ostatnim wyrazem, większy od @p begin
+ * @param[in] var : indeks zmiennej
+ * @return wielomian
+ */
+static Poly PolyFromFlatRange(const FlatPoly *f, size_t begin, size_t end, size_t var) {
+    if (var == f->vars) {
+        assert(end - begin == 1);
+        return PolyFromCoeff(f->coeffs[begin]);
     }
 
-    for(size_t i = 0; i < p->size; i++) {
-        MonoDestroy(&p->arr[i]);
+    // Wyrazy są posortowane, więc wyrazy o tym samym wykładniku zmiennej var sąsiadują.
+    size_t count = 1;
+    for (size_t i = begin + 1; i < end; i++) {
+        count += FlatGetExp(f, i, var) != FlatGetExp(f, i - 1, var);
     }
 
-    free(p->arr);
-}
+    poly_exp_t *exps = MonosAlloc(count);
+    Poly *coeffs = MonosCoeffs(exps);
+    size_t size = 0;
+    for (size_t i = begin; i < end;) {
+        poly_exp_t exp = FlatGetExp(f, i, var);
+        size_t j = i + 1;
+        while (j < end && FlatGetExp(f, j, var) == exp) {
+            j++;
+        }
 
-Poly PolyClone(const Poly *p) {
-    assert(PolyCheckIfCorrect(p));
-    return PolyMulByScalar(p, 1);
-}
+        exps[size] = exp;
+        coeffs[size++] = PolyFromFlatRange(f, i, j, var + 1);
+        i = j;
+    }
 
-Poly PolyNeg(const Poly *p) {
-    assert(PolyCheckIfCorrect(p));
-    return PolyMulByScalar(p, -1);
+    return PolyFromMonosArr(size, exps);
 }
 
-Poly PolySub(const Poly *p, const Poly *q) {
-    assert(PolyCheckIfCorrect(p));
-    assert(PolyCheckIfCorrect(q));
-    return PolyAddMulByScalars(p, q, 1, -1);
+Poly PolyFromFlat(const FlatPoly *f) {
+    if (f->size == 0) {
+        return PolyZero();
+    }
+
+    return PolyFromFlatRange(f, 0, f->size, 0);
 }
 
-poly_exp_t PolyDegBy(const Poly *p, size_t var_idx) {
-    assert(PolyCheckIfCorrect(p));
+/**
+ * Mnożymy w postaci płaskiej, gdy na jeden wyraz przypada średnio co najmniej tyle
+ * jednomianów drzewa (czyli warstwy mają średnio niewiele jednomianów).
+ */
+#define FLAT_MIN_MONOS_PER_TERM 2
 
-    if (PolyIsZero(p)) {
-        return -1;
-    }
+/**
+ * Element kopca w mnożeniu wielomianów: iloczyn jednomianów @f$ p_i @f$ i @f$ q_j @f$.
+ */
+typedef struct MulHeapItem {
+    /** Wykładnik iloczynu. */
+    poly_exp_t exp;
+    /** Indeks jednomianu pierwszego wielomianu. */
+    size_t i;
+    /** Indeks jednomianu drugiego wielomianu. */
+    size_t j;
+} MulHeapItem;
 
-    if (PolyIsCoeff(p)) {
-        return 0;
+/**
+ * Przywraca własność kopca (maksimum wykładnika w korzeniu) po zmianie korzenia.
+ * @param[in,out] heap : kopiec
+ * @param[in] size : liczba elementów kopca
+ */
+static void MulHeapSiftDown(MulHeapItem *heap, size_t size) {
+    if (size == 0) {
+        return;
     }
 
-    poly_exp_t result = -1;
+    size_t i = 0;
+    MulHeapItem item = heap[0];
 
-    if (var_idx == 0) {
-        for (size_t i = 0; i < p->size; i++) {
-            result = max(result, p->arr[i].exp);
+    while (2 * i + 1 < size) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < size && heap[child + 1].exp > heap[child].exp) {
+            child++;
         }
-    }
-    else {
-        for (size_t i = 0; i < p->size; i++) {
-            result = max(result, PolyDegBy(&p->arr[i].p, var_idx - 1));
+        if (heap[child].exp <= item.exp) {
+            break;
         }
+        heap[i] = heap[child];
+        i = child;
     }
-    return result;
-}
 
-Poly PolyAt (const Poly *p, poly_coeff_t x) {
-    assert(PolyCheckIfCorrect(p));
+    heap[i] = item;
+}
 
-    if (PolyIsCoeff(p)) {
-        return PolyFromCoeff(p->coeff);
+/**
+ * Mnoży liście algorytmem Johnsona (jak PolyMul), sumując iloczyny liczb od razu
+ * w tablicy wyniku, bez tworzenia wielomianów pośrednich.
+ * @param[in] p : wielomian będący liściem, nie dłuższy od @p q
+ * @param[in] q : wielomian będący liściem
+ * @return @f$ p * q @f$
+ */
+static Poly LeafMul(const Poly *p, const Poly *q) {
+    const poly_coeff_t *coeffs_p = LeafCoeffs(p->arr), *coeffs_q = LeafCoeffs(q->arr);
+    MulHeapItem *heap = (MulHeapItem*) ScratchAlloc(sizeof(MulHeapItem) * p->size);
+    size_t heap_size = p->size;
+    for (size_t i = 0; i < p->size; i++) {
+        heap[i] = (MulHeapItem) {.exp = p->arr[i] + q->arr[0], .i = i, .j = 0};
     }
 
-    // Wielomian wynikowy, który będziemy nadpisywać
-    // dodając do niego kolejne wielomiany przemnożone
-    // przez odpowiedni skalar.
-    Poly result = PolyZero();
+    size_t capacity = p->size + q->size;
+    poly_exp_t *exps_tmp = LeafAlloc(capacity);
+    size_t size = 0;
 
-    for (size_t i = 0; i < p->size; i++) {
-        poly_coeff_t s = power(x, MonoGetExp(&p->arr[i]));
-        if (s == 0) {
+    while (heap_size > 0) {
+        poly_exp_t exp = heap[0].exp;
+        uint64_t sum = 0;
+
+        while (heap_size > 0 && heap[0].exp == exp) {
+            MulHeapItem *top = &heap[0];
+            sum += (uint64_t) coeffs_p[top->i] * (uint64_t) coeffs_q[top->j];
+
+            if (++top->j < q->size) {
+                top->exp = p->arr[top->i] + q->arr[top->j];
+            }
+            else {
+                heap[0] = heap[--heap_size];
+            }
+            MulHeapSiftDown(heap, heap_size);
+        }
+
+        if (sum == 0) {
             continue;
         }
-        Poly tmp = PolyAddMulByScalars(&result, &p->arr[i].p, 1, s);
 
-        PolyDestroy(&result);
-        result = tmp;
+        if (size == capacity) {
+            capacity *= 2;
+            exps_tmp = MonosGrow(exps_tmp, size, capacity);
+        }
+        exps_tmp[size] = exp;
+        LeafCoeffs(exps_tmp)[size++] = (poly_coeff_t) sum;
     }
 
-    return result;
+    ScratchFree(heap);
+
+    return PolyFromMonosArr(size, exps_tmp);
 }
 
 Poly PolyMul(const Poly *p, const Poly *q) {
@@ -535,22 +1977,99 @@ Poly PolyMul(const Poly *p, const Poly *q) {
         }
     }
 
-    Mono *monos = (Mono*) safeMalloc (sizeof (Mono) * p->size * q->size);
-    size_t k = 0;
-    // Wymnażanie dwóch "nawiasów", wyniki pakujemy do tablicy.
+    size_t vars = 0, terms_p = 0, terms_q = 0, monos = 0;
+    poly_exp_t max_exp = 0;
+    PolyShape(p, 0, &vars, &terms_p, &monos, &max_exp);
+    PolyShape(q, 0, &vars, &terms_q, &monos, &max_exp);
+
+    Poly result;
+    if (PolyMulKronecker(p, q, vars, terms_p, terms_q, &result)) {
+        return result;
+    }
+
+    // Iloczyn wielomianów o wąskich, głębokich drzewach liczymy w postaci płaskiej,
+    // bez rekurencyjnych mnożeń i dodawań podwielomianów (przy szerokich warstwach
+    // rekurencyjne kopce są mniejsze i to one wygrywają).
+    if (vars >= 2 && monos >= FLAT_MIN_MONOS_PER_TERM * (terms_p + terms_q)) {
+        FlatPoly flat_p = PolyToFlat(p);
+        FlatPoly flat_q = PolyToFlat(q);
+        FlatPoly product = FlatMul(&flat_p, &flat_q);
+        result = PolyFromFlat(&product);
+
+        FlatDestroy(&product);
+        FlatDestroy(&flat_q);
+        FlatDestroy(&flat_p);
+        return result;
+    }
+
+    // Krótszy wielomian wyznacza rozmiar kopca.
+    if (p->size > q->size) {
+        const Poly *tmp = p;
+        p = q;
+        q = tmp;
+    }
+
+    if (MonosIsLeaf(p->arr) && MonosIsLeaf(q->arr)) {
+        return LeafMul(p, q);
+    }
+
+    // Algorytm Johnsona: kopiec trzyma dla każdego jednomianu p następny jednomian q,
+    // przez który jeszcze go nie wymnożyliśmy, iloczyny wychodzą z kopca malejąco po wykładniku.
+    MulHeapItem *heap = (MulHeapItem*) ScratchAlloc(sizeof(MulHeapItem) * p->size);
+    size_t heap_size = p->size;
     for (size_t i = 0; i < p->size; i++) {
-        for (size_t j = 0; j < q->size; j++) {
-            monos[k] = (Mono) {.exp = MonoGetExp(&p->arr[i]) + MonoGetExp(&q->arr[j]),
-                    .p = PolyMul(&p->arr[i].p, &q->arr[j].p)};
-            k++;
+        heap[i] = (MulHeapItem) {.exp = p->arr[i] + q->arr[0], .i = i, .j = 0};
+    }
+    // Wykładniki p są malejące, więc tablica już jest kopcem.
+
+    size_t capacity = p->size + q->size;
+    poly_exp_t *exps_tmp = MonosAlloc(capacity);
+    size_t size = 0;
+
+    while (heap_size > 0) {
+        poly_exp_t exp = heap[0].exp;
+        Poly sum = PolyZero();
+
+        // Sumujemy od razu wszystkie iloczyny o tym samym wykładniku.
+        while (heap_size > 0 && heap[0].exp == exp) {
+            MulHeapItem *top = &heap[0];
+            Poly coeff_p = MonosCoeffAt(p->arr, top->i), coeff_q = MonosCoeffAt(q->arr, top->j);
+            Poly product = PolyMul(&coeff_p, &coeff_q);
+
+            if (PolyIsCoeff(&sum) && PolyIsCoeff(&product)) {
+                sum.coeff += product.coeff;
+            }
+            else {
+                Poly tmp = PolyAdd(&sum, &product);
+                PolyDestroy(&sum);
+                PolyDestroy(&product);
+                sum = tmp;
+            }
+
+            if (++top->j < q->size) {
+                top->exp = p->arr[top->i] + q->arr[top->j];
+            }
+            else {
+                heap[0] = heap[--heap_size];
+            }
+            MulHeapSiftDown(heap, heap_size);
+        }
+
+        if (PolyIsZero(&sum)) {
+            continue;
         }
+
+        if (size == capacity) {
+            capacity *= 2;
+            exps_tmp = MonosGrow(exps_tmp, size, capacity);
+        }
+        exps_tmp[size] = exp;
+        MonosCoeffs(exps_tmp)[size++] = sum;
     }
 
-    // Wynikowy wielomian będzie sumą jednomianów otrzymanych po
-    // wymnożeniu "każdego z każdym".
-    Poly result = PolyAddMonos(k, monos);
-    free(monos);
-    return result;
+    ScratchFree(heap);
+
+    return PolyFromMonosArr(size, exps_tmp);
 }
 
 void PolyPrint(const Poly *p) {
@@ -563,8 +2082,9 @@ void PolyPrint(const Poly *p) {
         while (flag) {
             if (i != p->size - 1) printf("+");
             printf("(");
-            PolyPrint(&p->arr[i].p);
-            printf(",%d)", p->arr[i].exp);
+            Poly coeff = MonosCoeffAt(p->arr, i);
+            PolyPrint(&coeff);
+            printf(",%d)", p->arr[i]);
             if(!i) flag = false;
             i--;
         }
@@ -576,52 +2096,10 @@ Poly PolyOwnMonos(size_t count, Mono *monos) {
     if (count == 0 || monos == NULL)
         return PolyZero();
 
-    // Sortowanie tablicy jednomianów malejąco po wykładniku.
-    qsort(monos, count, sizeof(Mono), monoCmp);
-
-    size_t size = count;
-    for (size_t i = 0; i < count; i++) {
-        Mono cur = monos[i];
-
-        // Jeśli aktualny wielomian jest zerem, to oznaczamy go flagą (exp = -1).
-        // Dzięki temu, przy następnym sortowaniu, znajdzie się on
-        // za poprawnymi jednomianami.
-        if (PolyIsZero(&cur.p)) {
-            monos[i].exp = -1;
-            size--;
-        }
-        else if (i < count - 1) {
-            Mono next = monos[i + 1];
-            // Dodajemy sąsiadów o tym samym wykładniku.
-            if (MonoGetExp(&cur) == MonoGetExp(&next)) {
-                Mono tmp = next;
-                monos[i + 1].p = PolyAdd(&cur.p, &tmp.p);
-                monos[i].exp = -1;
-
-                PolyDestroy(&cur.p);
-                PolyDestroy(&tmp.p);
-
-                size--;
-            }
-        }
-    }
-
-    if (size == 0) {
-        free(monos);
-        return PolyZero();
-    }
-
-    // Drugie sortowanie, wyzerowane jednomiany (exp = -1) trafiają na koniec tablicy.
-    qsort(monos, count, sizeof(Mono), monoCmp);
-
-    // Zachowanie niezmiennika 2).
-    if (size == 1 && PolyIsCoeff(&monos[0].p) && MonoGetExp(&monos[0]) == 0) {
-        Poly result = PolyFromCoeff(monos[0].p.coeff);
-        free(monos);
-        return result;
-    }
-
-    return (Poly) {.size = size, .arr = monos};
+    // Tablica użytkownika jest sortowana i zagęszczana w miejscu.
+    Poly result = MonosSortAndSum(count, monos);
+    safeFree(monos);
+    return result;
 }
 
 Poly PolyCloneMonos(size_t count, const Mono monos[]) {
@@ -631,57 +2109,18 @@ Poly PolyCloneMonos(size_t count, const Mono monos[]) {
     }
 
     // Przepisywanie wejściowej tablicy.
-    Mono *monos_tmp = (Mono*) safeMalloc (sizeof(Mono) * (count + 1));
+    Mono *monos_tmp = (Mono*) ScratchAlloc(sizeof(Mono) * count);
     for (size_t i = 0; i < count; i++) {
         monos_tmp[i] = MonoClone(&monos[i]);
     }
-    // Placeholder, dzięki temu nie martwimy się o wyjście poza zakres tablicy.
-    monos_tmp[count] = (Mono) {.exp = -2};
-    // Sortowanie tablicy jednomianów malejąco po wykładniku.
-    qsort(monos_tmp, count + 1, sizeof(Mono), monoCmp);
-
-    size_t size = count;
-    for (size_t i = 0; i < count; i++) {
-        assert (monos_tmp[i].exp >= monos_tmp[i + 1].exp);
-        Mono cur = monos_tmp[i];
-        Mono next = monos_tmp[i + 1];
-
-        // Jeśli aktualny wielomian jest zerem, to oznaczamy go flagą (exp = -1).
-        // Dzięki temu, przy następnym sortowaniu, znajdzie się on
-        // za poprawnymi jednomianami.
-        if (PolyIsZero(&cur.p)) {
-            monos_tmp[i].exp = -1;
-            size--;
-        }
-            // Dodajemy sąsiadów o tym samym wykładniku.
-        else if (MonoGetExp(&cur) == MonoGetExp(&next)) {
-            Mono tmp = next;
-            monos_tmp[i + 1].p = PolyAdd(&cur.p, &tmp.p);
-            monos_tmp[i].exp = -1;
-
-            PolyDestroy(&cur.p);
-            PolyDestroy(&tmp.p);
-
-            size--;
-        }
-    }
-
-    if (size == 0) {
-        free(monos_tmp);
-        return PolyZero();
-    }
 
-    // Drugie sortowanie, wyzerowane jednomiany (exp = -1) trafiają na koniec tablicy.
-    qsort(monos_tmp, count + 1, sizeof(Mono), monoCmp);
-
-    // Zachowanie niezmiennika 2).
-    if (size == 1 && PolyIsCoeff(&monos_tmp[0].p) && MonoGetExp(&monos_tmp[0]) == 0) {
-        Poly result = PolyFromCoeff(monos_tmp[0].p.coeff);
-        free(monos_tmp);
-        return result;
-    }
+    Poly result = MonosSortAndSum(count, monos_tmp);
+    ScratchFree(monos_tmp);
+    return result;
+}
 
-    return (Poly) {.size = size, .arr = monos_tmp};
+void PolyHashConsing(bool enabled) {
+    hash_consing = enabled;
 }
 
 Poly PolyPow(const Poly *p, poly_exp_t exp) {
@@ -721,8 +2160,9 @@ Poly PolyCompose(const Poly *p, size_t k, const Poly q[]) {
         return PolyFromCoeff(p->coeff);
 
     if (k == 0) {
-        if (MonoGetExp(&p->arr[p->size - 1]) == 0) {
-            return PolyCompose(&p->arr[p->size - 1].p, 0, q);
+        if (p->arr[p->size - 1] == 0) {
+            Poly coeff = MonosCoeffAt(p->arr, p->size - 1);
+            return PolyCompose(&coeff, 0, q);
         }
         else {
             return PolyZero();
@@ -731,8 +2171,9 @@ Poly PolyCompose(const Poly *p, size_t k, const Poly q[]) {
 
     Poly res = PolyZero();
     for (size_t i = 0; i < p->size; i++) {
-        Poly p1 = PolyPow(&q[k - 1], MonoGetExp(&p->arr[i]));
-        Poly p2 = PolyCompose(&p->arr[i].p, k - 1, q);
+        Poly p1 = PolyPow(&q[k - 1], p->arr[i]);
+        Poly coeff = MonosCoeffAt(p->arr, i);
+        Poly p2 = PolyCompose(&coeff, k - 1, q);
         Poly p3 = PolyMul(&p1, &p2);
         PolyDestroy(&p1);
         PolyDestroy(&p2);
@@ -37,8 +37,11 @@ typedef struct Poly {
     poly_coeff_t coeff; ///< współczynnik
     size_t       size; ///< rozmiar wielomianu, liczba jednomianów
   };
-  /** To jest tablica przechowująca listę jednomianów. */
-  struct Mono *arr;
+  /**
+   * To jest tablica wykładników jednomianów (malejących). Współczynniki jednomianów
+   * leżą w tej samej alokacji, za wykładnikami, więc jednomiany czyta się przez PolyGetMono.
+   */
+  poly_exp_t *arr;
 } Poly;
 
 /**
@@ -116,6 +119,13 @@ static inline bool PolyIsZero(const Poly *p) {
  */
 void PolyDestroy(Poly *p);
 
+/**
+ * Zwalnia pamięć, którą moduł przechowuje do ponownego użycia w bieżącym wątku:
+ * tablice usuniętych wielomianów, których PolyDestroy nie zdążył jeszcze zwolnić,
+ * i pamięć na tablice tymczasowe. Nie unieważnia żadnego wielomianu.
+ */
+void PolyFreeCaches(void);
+
 /**
  * Usuwa jednomian z pamięci.
  * @param[in] m : jednomian
@@ -125,7 +135,9 @@ static inline void MonoDestroy(Mono *m) {
 }
 
 /**
- * Robi pełną, głęboką kopię wielomianu.
+ * Robi kopię wielomianu w czasie stałym.
+ * Kopia współdzieli tablice jednomianów z oryginałem (kopiowane są dopiero przed zmianą),
+ * więc obu wielomianów można używać i usuwać je niezależnie.
  * @param[in] p : wielomian
  * @return skopiowany wielomian
  */
@@ -140,6 +152,15 @@ static inline Mono MonoClone(const Mono *m) {
   return (Mono) {.p = PolyClone(&m->p), .exp = m->exp};
 }
 
+/**
+ * Daje jednomian wielomianu, bez kopiowania: jego współczynnik należy nadal
+ * do wielomianu @p p i nie wolno go usuwać ani zmieniać.
+ * @param[in] p : wielomian niebędący współczynnikiem
+ * @param[in] i : indeks jednomianu, mniejszy od `p->size`
+ * @return jednomian o @p i-tym co do wielkości wykładniku
+ */
+Mono PolyGetMono(const Poly *p, size_t i);
+
 /**
  * Dodaje dwa wielomiany.
  * @param[in] p : wielomian @f$p@f$
@@ -221,23 +242,48 @@ bool PolyIsEq(const Poly *p, const Poly *q);
 Poly PolyAt(const Poly *p, poly_coeff_t x);
 
 /**
- * Bezpieczna alokacja pamięci.
- * Program zostaje zakończony kodem 1 w przypadku braku pamięci.
- * @param[in] size : rozmiar alokowanej pamięci
- * @return void* : zaalokowany wskaźnik
+ * Dodaje dwa wielomiany, przejmując je na własność (po wywołaniu nie trzeba
+ * i nie wolno ich usuwać). Nie współdzielone tablice jednomianów są używane
+ * ponownie: wynik powstaje w tablicy większego z wielomianów.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
  */
-void* safeMalloc (size_t size);
+Poly PolyAddOwn(Poly *p, Poly *q);
 
+/**
+ * Odejmuje wielomian od wielomianu, przejmując je na własność (jak PolyAddOwn).
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p - q@f$
+ */
+Poly PolySubOwn(Poly *p, Poly *q);
 
 /**
- * Bezpieczna realokacja pamięci.
- * Program zostaje zakończony kodem 1 w przypadku braku pamięci.
- * @param[in] ptr : realokowany wskaźnik
- * @param[in] size : rozmiar alokowanej pamięci
- * @return void* : nowo zarealokowany wskaźnik
+ * Mnoży dwa wielomiany, przejmując je na własność (jak PolyAddOwn).
+ * Mnożenie przez liczbę odbywa się w miejscu.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
  */
-void* safeRealloc (void *ptr, size_t size);
+Poly PolyMulOwn(Poly *p, Poly *q);
 
+/**
+ * Zwraca przeciwny wielomian, przejmując @p p na własność.
+ * Nie współdzielone tablice jednomianów są zmieniane w miejscu.
+ * @param[in] p : wielomian @f$p@f$
+ * @return @f$-p@f$
+ */
+Poly PolyNegOwn(Poly *p);
+
+/**
+ * Wylicza wartość wielomianu w punkcie @p x (jak PolyAt), przejmując @p p
+ * na własność. Współczynniki nie współdzielonej tablicy trafiają do wyniku bez kopiowania.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @return @f$p(x, x_0, x_1, \ldots)@f$
+ */
+Poly PolyAtOwn(Poly *p, poly_coeff_t x);
 
 /**
  * Wypisuje na standardowe wyjście wielomian @p p
@@ -291,4 +337,14 @@ Poly PolyCompose(const Poly *p, size_t k, const Poly q[]);
  */
 Poly PolyPow(const Poly *p, poly_exp_t exp);
 
+/**
+ * Włącza lub wyłącza hash-consing wielomianów.
+ * W tym trybie równe tablice jednomianów tworzonych wielomianów są współdzielone
+ * (przechowywane w globalnej tablicy haszującej, która nie przedłuża ich życia),
+ * więc PolyIsEq dla takich wielomianów porównuje tylko adresy.
+ * Wielomiany utworzone przed włączeniem trybu pozostają poprawne.
+ * @param[in] enabled : czy włączyć hash-consing
+ */
+void PolyHashConsing(bool enabled);
+
 #endif /* __POLY_H__ */
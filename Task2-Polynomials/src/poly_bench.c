@@ -0,0 +1,274 @@
+/** @file
+  * Plik poly_bench.c. Pomiary wydajności operacji na wielomianach
+  * (cel bench, korzysta z biblioteki Common/bench.h wspólnej z Task1).
+
+  @author Mikołaj Uzarski
+  @date 2021
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "poly.h"
+#include "dense.h"
+#include "safe_alloc.h"
+#include "bench.h"
+
+/**
+ * Liczba wielomianów w każdym pomiarze.
+ */
+#define BENCH_POLYS 256
+
+/**
+ * Liczba powtórzeń każdego pomiaru.
+ */
+#define BENCH_ROUNDS 8
+
+/**
+ * Największy rozmiar wielomianów w porównaniu algorytmów mnożenia gęstego.
+ */
+#define BENCH_DENSE_MAX_SIZE 32768
+
+/**
+ * Generator liczb pseudolosowych (xorshift), niezależny od biblioteki standardowej.
+ * @param[in,out] state : stan generatora
+ * @return kolejna liczba pseudolosowa
+ */
+static uint64_t NextRandom(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * Tworzy losowy wielomian.
+ * @param[in,out] state : stan generatora
+ * @param[in] depth : liczba zmiennych
+ * @param[in] size : maksymalna liczba jednomianów w każdej warstwie
+ * @param[in] max_exp : maksymalny wykładnik
+ * @return losowy wielomian
+ */
+static Poly RandomPoly(uint64_t *state, int depth, size_t size, poly_exp_t max_exp) {
+    if (depth == 0)
+        return PolyFromCoeff((poly_coeff_t) (NextRandom(state) % 2001) - 1000);
+
+    size_t count = 1 + NextRandom(state) % size;
+    Mono *monos = (Mono*) safeMalloc(sizeof(Mono) * count);
+
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        Poly coeff = RandomPoly(state, depth - 1, size, max_exp);
+        poly_exp_t exp = (poly_exp_t) (NextRandom(state) % (max_exp + 1));
+        // Jednomian o zerowym współczynniku nie spełnia warunku MonoFromPoly.
+        if (!PolyIsZero(&coeff))
+            monos[used++] = MonoFromPoly(&coeff, exp);
+    }
+
+    // PolyAddMonos przejmuje zawartość jednomianów, ale nie tablicę
+    Poly result = PolyAddMonos(used, monos);
+    free(monos);
+
+    return result;
+}
+
+/**
+ * Zwraca łączną liczbę jednomianów wielomianu (we wszystkich warstwach).
+ * @param[in] p : wielomian
+ * @return liczba jednomianów
+ */
+static uint64_t PolyMonosCount(const Poly *p) {
+    if (PolyIsCoeff(p))
+        return 0;
+
+    uint64_t count = p->size;
+    for (size_t i = 0; i < p->size; i++) {
+        Mono m = PolyGetMono(p, i);
+        count += PolyMonosCount(&m.p);
+    }
+
+    return count;
+}
+
+/**
+ * Mierzy operację dwuargumentową na kolejnych parach wielomianów.
+ * Operacją pomiaru jest para wielomianów.
+ * @param[in] name : nazwa pomiaru
+ * @param[in] op : operacja
+ * @param[in] polys : wielomiany
+ */
+static void BenchBinaryOp(const char *name, Poly (*op)(const Poly*, const Poly*), const Poly polys[]) {
+    Bench bench;
+    bench_init(&bench, name);
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        Poly results[BENCH_POLYS - 1];
+
+        bench_start(&bench);
+        for (int i = 0; i + 1 < BENCH_POLYS; i++)
+            results[i] = op(&polys[i], &polys[i + 1]);
+        bench_stop(&bench, BENCH_POLYS - 1);
+
+        // zwalnianie wyników nie wchodzi do pomiaru
+        for (int i = 0; i + 1 < BENCH_POLYS; i++)
+            PolyDestroy(&results[i]);
+    }
+
+    bench_report(&bench, stdout);
+    bench_free(&bench);
+}
+
+/**
+ * Mierzy wartościowanie kolejnych wielomianów.
+ * Operacją pomiaru jest jednomian argumentu.
+ * @param[in] polys : wielomiany
+ */
+static void BenchAt(const Poly polys[]) {
+    Bench bench;
+    bench_init(&bench, "PolyAt");
+
+    uint64_t monos = 0;
+    for (int i = 0; i < BENCH_POLYS; i++)
+        monos += PolyMonosCount(&polys[i]) + 1;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        Poly results[BENCH_POLYS];
+
+        bench_start(&bench);
+        for (int i = 0; i < BENCH_POLYS; i++)
+            results[i] = PolyAt(&polys[i], (poly_coeff_t) (round + 2));
+        bench_stop(&bench, monos);
+
+        for (int i = 0; i < BENCH_POLYS; i++)
+            PolyDestroy(&results[i]);
+    }
+
+    bench_report(&bench, stdout);
+    bench_free(&bench);
+}
+
+/**
+ * Mierzy porównywanie kolejnych par wielomianów (w tym każdego z jego kopią).
+ * Operacją pomiaru jest porównanie.
+ * @param[in] polys : wielomiany
+ */
+static void BenchIsEq(const Poly polys[]) {
+    Poly clones[BENCH_POLYS];
+    for (int i = 0; i < BENCH_POLYS; i++)
+        clones[i] = PolyClone(&polys[i]);
+
+    Bench bench;
+    bench_init(&bench, "PolyIsEq");
+    uint64_t equal = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        bench_start(&bench);
+        for (int i = 0; i < BENCH_POLYS; i++)
+            equal += PolyIsEq(&polys[i], &clones[(i + round) % BENCH_POLYS]);
+        bench_stop(&bench, BENCH_POLYS);
+    }
+
+    bench_use(equal);
+    bench_report(&bench, stdout);
+    bench_free(&bench);
+
+    for (int i = 0; i < BENCH_POLYS; i++)
+        PolyDestroy(&clones[i]);
+}
+
+/**
+ * Zestaw pomiarów na wielomianach o zadanym kształcie.
+ * @param[in] title : opis kształtu
+ * @param[in] depth : liczba zmiennych
+ * @param[in] size : maksymalna liczba jednomianów w każdej warstwie
+ * @param[in] max_exp : maksymalny wykładnik
+ */
+static void BenchShape(const char *title, int depth, size_t size, poly_exp_t max_exp) {
+    uint64_t state = 0x9E3779B97F4A7C15u + (uint64_t) depth * 1000 + size;
+    Poly polys[BENCH_POLYS];
+
+    for (int i = 0; i < BENCH_POLYS; i++)
+        polys[i] = RandomPoly(&state, depth, size, max_exp);
+
+    printf("# %s\n", title);
+    BenchBinaryOp("PolyAdd", PolyAdd, polys);
+    BenchBinaryOp("PolySub", PolySub, polys);
+    BenchBinaryOp("PolyMul", PolyMul, polys);
+    BenchAt(polys);
+    BenchIsEq(polys);
+
+    for (int i = 0; i < BENCH_POLYS; i++)
+        PolyDestroy(&polys[i]);
+}
+
+/**
+ * Mierzy jeden algorytm mnożenia gęstych wielomianów.
+ * Operacją pomiaru jest jedno mnożenie.
+ * @param[in] name : nazwa pomiaru
+ * @param[in] mul : algorytm mnożenia
+ * @param[in] a : tablica @p len współczynników
+ * @param[in] b : tablica @p len współczynników
+ * @param[in] len : liczba współczynników
+ * @param[out] res : tablica na @f$ 2len-1 @f$ współczynników
+ */
+static void BenchDenseMul(const char *name,
+                          void (*mul)(const dense_coeff_t*, size_t, const dense_coeff_t*, size_t, dense_coeff_t*),
+                          const dense_coeff_t *a, const dense_coeff_t *b, size_t len, dense_coeff_t *res) {
+    Bench bench;
+    bench_init(&bench, name);
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        bench_start(&bench);
+        mul(a, len, b, len, res);
+        bench_stop(&bench, 1);
+    }
+
+    bench_use(res[len - 1]);
+    bench_report(&bench, stdout);
+    bench_free(&bench);
+}
+
+/**
+ * Porównuje mnożenie Karatsuby i przez NTT dla rosnących rozmiarów,
+ * pokazując punkt przecięcia (DENSE_NTT_CUTOFF w dense.h).
+ */
+static void BenchDenseCrossover(void) {
+    uint64_t state = 0x2545F4914F6CDD1Du;
+    dense_coeff_t *a = (dense_coeff_t*) safeMalloc(sizeof(dense_coeff_t) * BENCH_DENSE_MAX_SIZE);
+    dense_coeff_t *b = (dense_coeff_t*) safeMalloc(sizeof(dense_coeff_t) * BENCH_DENSE_MAX_SIZE);
+    dense_coeff_t *res = (dense_coeff_t*) safeMalloc(sizeof(dense_coeff_t) * 2 * BENCH_DENSE_MAX_SIZE);
+
+    for (size_t i = 0; i < BENCH_DENSE_MAX_SIZE; i++) {
+        a[i] = NextRandom(&state);
+        b[i] = NextRandom(&state);
+    }
+
+    printf("# mnożenie gęste, Karatsuba i NTT\n");
+    for (size_t len = 64; len <= BENCH_DENSE_MAX_SIZE; len *= 2) {
+        char name[2][32];
+        snprintf(name[0], sizeof(name[0]), "Karatsuba %zu", len);
+        snprintf(name[1], sizeof(name[1]), "NTT %zu", len);
+
+        BenchDenseMul(name[0], DenseMulKaratsuba, a, b, len, res);
+        BenchDenseMul(name[1], DenseMulNtt, a, b, len, res);
+    }
+
+    safeFree(res);
+    safeFree(b);
+    safeFree(a);
+}
+
+/**
+ * Główna funkcja programu.
+ * @return kod zakończenia programu
+ */
+int main() {
+    bench_report_header(stdout);
+
+    BenchShape("jedna zmienna, rzadkie", 1, 64, 1000);
+    BenchShape("jedna zmienna, gęste", 1, 64, 64);
+    BenchShape("trzy zmienne", 3, 8, 16);
+    BenchDenseCrossover();
+
+    return 0;
+}
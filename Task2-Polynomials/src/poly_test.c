@@ -3,6 +3,8 @@
 #endif
 
 #include "poly.h"
+#include "flat.h"
+#include "dense.h"
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
@@ -4146,6 +4148,253 @@ static bool MemoryGroup(void) {
   return RarePolynomialTest() && MemoryThiefTest() && MemoryFreeTest();
 }
 
+static bool HashConsingTest(void) {
+  PolyHashConsing(true);
+  bool res = true;
+
+  Poly p = P(P(C(1), 0, C(2), 1), 0, P(C(1), 0, C(2), 1), 3);
+  Poly q = P(P(C(1), 0, C(2), 1), 0, P(C(1), 0, C(2), 1), 3);
+  Poly r = PolyAdd(&p, &q);
+  Poly s = PolySub(&r, &q);
+  // Równe wielomiany mają tę samą tablicę, także we współczynnikach.
+  res &= p.arr == q.arr && PolyGetMono(&p, 0).p.arr == PolyGetMono(&p, 1).p.arr;
+  res &= s.arr == p.arr && PolyIsEq(&s, &q) && !PolyIsEq(&r, &q);
+  PolyDestroy(&p);
+  PolyDestroy(&r);
+  res &= PolyIsEq(&s, &q);
+  PolyDestroy(&q);
+  PolyDestroy(&s);
+
+  res &= ArithmeticGroup() && MemoryGroup();
+  PolyHashConsing(false);
+  return res;
+}
+
+static bool DeferredDestroyTest(void) {
+  bool res = true;
+
+  // Głęboki łańcuch wielomianów, którego część jest współdzielona z innym wielomianem.
+  Poly chain = C(1), shared = C(0);
+  for (int i = 0; i < 100000; i++) {
+    Mono m = MonoFromPoly(&chain, 1);
+    chain = PolyAddMonos(1, &m);
+    if (i == 1000)
+      shared = PolyClone(&chain);
+  }
+  res &= PolyDeg(&chain) == 100000;
+  PolyDestroy(&chain);
+
+  Poly p = P(C(1), 0, C(2), 1);
+  Poly q = PolyMul(&shared, &p);
+  PolyFreeCaches();
+  res &= PolyDeg(&shared) == 1001 && PolyDeg(&q) == 1002;
+  PolyDestroy(&shared);
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  PolyFreeCaches();
+
+  return res;
+}
+
+static bool OwnTest(void) {
+  bool res = true;
+  Poly polys[] = {
+    C(5),
+    P(C(1), 0, C(2), 1, C(-1), 3),
+    P(P(C(1), 1), 0, C(2), 2, P(C(-2), 0, C(1), 4), 4),
+    P(P(C(-1), 1), 0, C(-2), 2, P(C(2), 0, C(-1), 4), 4, C(1), 5),
+  };
+  size_t n = sizeof(polys) / sizeof(polys[0]);
+
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      Poly (*own[])(Poly *, Poly *) = {PolyAddOwn, PolySubOwn, PolyMulOwn};
+      Poly (*ref[])(const Poly *, const Poly *) = {PolyAdd, PolySub, PolyMul};
+
+      for (size_t k = 0; k < 3; k++) {
+        // Na zmianę z tablicami współdzielonymi i nie (-(-p) ma nowe tablice).
+        Poly neg = PolyNeg(&polys[i]);
+        Poly p = j % 2 == 0 ? PolyClone(&polys[i]) : PolyNeg(&neg);
+        Poly q = PolyClone(&polys[j]);
+        PolyDestroy(&neg);
+        Poly expected = ref[k](&polys[i], &polys[j]);
+        Poly got = own[k](&p, &q);
+        res &= PolyIsEq(&got, &expected);
+        PolyDestroy(&got);
+        PolyDestroy(&expected);
+      }
+    }
+
+    Poly p = PolyClone(&polys[i]);
+    Poly expected = PolyNeg(&polys[i]);
+    Poly got = PolyNegOwn(&p);
+    res &= PolyIsEq(&got, &expected);
+    PolyDestroy(&got);
+    PolyDestroy(&expected);
+
+    for (poly_coeff_t x = -2; x <= 2; x++) {
+      p = PolyClone(&polys[i]);
+      expected = PolyAt(&polys[i], x);
+      got = PolyAtOwn(&p, x);
+      res &= PolyIsEq(&got, &expected);
+      PolyDestroy(&got);
+      PolyDestroy(&expected);
+    }
+  }
+
+  for (size_t i = 0; i < n; i++)
+    PolyDestroy(&polys[i]);
+
+  return res;
+}
+
+static bool SortMonosTest(void) {
+  bool res = true;
+  // Ponad 32 jednomiany (sortowanie pozycyjne), z wykładnikami różniącymi się
+  // na kilku cyfrach, powtórzeniami i jednomianami, które się znoszą.
+  Mono monos[300];
+  Poly expected = C(0);
+  for (int i = 0; i < 300; i++) {
+    poly_exp_t exp = (i * 7919) % 50 * 70001 % 100000;
+    Poly p = i % 3 == 0 ? P(C(i), 0, C(1), 1) : C(i % 2 == 0 ? i : -i);
+    if (i % 5 == 0) {
+      Poly one = C(-1);
+      p = PolyAddOwn(&p, &one);
+    }
+    monos[i] = MonoFromPoly(&p, exp);
+    Mono single = MonoClone(&monos[i]);
+    Poly m = PolyAddMonos(1, &single);
+    expected = PolyAddOwn(&expected, &m);
+  }
+
+  Poly cloned = PolyCloneMonos(300, monos);
+  Mono copy[300];
+  for (int i = 0; i < 300; i++)
+    copy[i] = MonoClone(&monos[i]);
+  Poly added = PolyAddMonos(300, copy);
+  Mono *owned = malloc(sizeof(monos));
+  memcpy(owned, monos, sizeof(monos));
+  Poly own = PolyOwnMonos(300, owned);
+  res &= PolyIsEq(&cloned, &expected) && PolyIsEq(&own, &expected) && PolyIsEq(&added, &expected);
+
+  // Wszystkie jednomiany się znoszą.
+  for (int i = 0; i < 300; i++)
+    copy[i] = (Mono) {.p = C(i % 2 == 0 ? 1 : -1), .exp = i / 2 * 1000};
+  Poly zero = PolyAddMonos(300, copy);
+  res &= PolyIsZero(&zero);
+
+  PolyDestroy(&cloned);
+  PolyDestroy(&own);
+  PolyDestroy(&added);
+  PolyDestroy(&expected);
+  return res;
+}
+
+static bool DenseMulNttTest(void) {
+  bool res = true;
+  // Iloczyny o n + m - 1 współczynnikach tuż pod, równo i tuż nad potęgą dwójki.
+  size_t sizes[][2] = {{DENSE_NTT_CUTOFF, DENSE_NTT_CUTOFF},
+                       {DENSE_NTT_CUTOFF, DENSE_NTT_CUTOFF + 1},
+                       {DENSE_NTT_CUTOFF + 2, DENSE_NTT_CUTOFF}};
+  uint64_t state = 88172645463325252ULL;
+
+  for (size_t t = 0; t < 4; t++) {
+    size_t n = sizes[t % 3][0], m = sizes[t % 3][1];
+    dense_coeff_t *a = malloc(sizeof(dense_coeff_t) * n);
+    dense_coeff_t *b = malloc(sizeof(dense_coeff_t) * m);
+    dense_coeff_t *ntt = malloc(sizeof(dense_coeff_t) * (n + m - 1));
+    dense_coeff_t *mul = malloc(sizeof(dense_coeff_t) * (n + m - 1));
+    dense_coeff_t *expected = malloc(sizeof(dense_coeff_t) * (n + m - 1));
+    CHECK_PTR(a);
+    CHECK_PTR(b);
+    CHECK_PTR(ntt);
+    CHECK_PTR(mul);
+    CHECK_PTR(expected);
+
+    // Ostatni przypadek to same -1, czyli największe współczynniki przed redukcją.
+    for (size_t i = 0; i < n + m; i++) {
+      poly_coeff_t extremes[] = {LONG_MIN, LONG_MAX, -1};
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      dense_coeff_t c = t == 3 ? (dense_coeff_t) -1
+                      : i % 5 == 0 ? (dense_coeff_t) extremes[i / 5 % 3] : state;
+      if (i < n)
+        a[i] = c;
+      else
+        b[i - n] = c;
+    }
+
+    DenseMulNtt(a, n, b, m, ntt);
+    DenseMul(a, n, b, m, mul);
+    DenseMulKaratsuba(a, n, b, m, expected);
+    res &= memcmp(ntt, expected, sizeof(dense_coeff_t) * (n + m - 1)) == 0;
+    res &= memcmp(mul, expected, sizeof(dense_coeff_t) * (n + m - 1)) == 0;
+
+    // Kilka współczynników liczonych wprost, niezależnie od obu algorytmów.
+    for (size_t k = 0; k < n + m - 1; k += 4093) {
+      dense_coeff_t c = 0;
+      for (size_t i = k >= m ? k - m + 1 : 0; i < n && i <= k; i++)
+        c += a[i] * b[k - i];
+      res &= ntt[k] == c;
+    }
+
+    free(a);
+    free(b);
+    free(ntt);
+    free(mul);
+    free(expected);
+  }
+
+  return res;
+}
+
+static bool FlatTest(void) {
+  bool res = true;
+
+  Poly p = P(P(C(1), 0, C(2), 1), 0, P(C(-1), 2), 3, C(5), 200);
+  Poly q = P(P(C(3), 1), 0, P(C(1), 0, C(1), 70000), 3);
+  FlatPoly fp = PolyToFlat(&p);
+  FlatPoly fq = PolyToFlat(&q);
+  res &= fp.size == 4 && fp.vars == 2 && fq.bits == 32;
+  res &= FlatGetExp(&fp, 0, 0) == 200 && FlatGetExp(&fp, 1, 1) == 2;
+
+  FlatPoly fs = FlatAdd(&fp, &fq);
+  FlatPoly fn = FlatNeg(&fq);
+  FlatPoly fm = FlatMul(&fp, &fq);
+  FlatPoly fz = FlatAdd(&fq, &fn);
+  Poly ps = PolyFromFlat(&fs);
+  Poly pn = PolyFromFlat(&fn);
+  Poly pm = PolyFromFlat(&fm);
+  Poly pz = PolyFromFlat(&fz);
+  Poly back = PolyFromFlat(&fp);
+
+  Poly s = PolyAdd(&p, &q);
+  Poly n = PolyNeg(&q);
+  Poly m = PolyMul(&p, &q);
+  res &= PolyIsEq(&ps, &s) && PolyIsEq(&pn, &n) && PolyIsEq(&pm, &m);
+  res &= PolyIsZero(&pz) && fz.size == 0 && PolyIsEq(&back, &p);
+  res &= FlatIsEq(&fp, &fp) && !FlatIsEq(&fp, &fq);
+
+  FlatDestroy(&fp);
+  FlatDestroy(&fq);
+  FlatDestroy(&fs);
+  FlatDestroy(&fn);
+  FlatDestroy(&fm);
+  FlatDestroy(&fz);
+  PolyDestroy(&ps);
+  PolyDestroy(&pn);
+  PolyDestroy(&pm);
+  PolyDestroy(&pz);
+  PolyDestroy(&back);
+  PolyDestroy(&s);
+  PolyDestroy(&n);
+  PolyDestroy(&m);
+  PolyDestroy(&p);
+  PolyDestroy(&q);
+  return res;
+}
+
 /** URUCHAMIANIE TESTÓW **/
 
 // Liczba elementów tablicy x
@@ -4209,6 +4458,12 @@ static const test_list_t test_list[] = {
   TEST(MemoryThiefTest),
   TEST(MemoryFreeTest),
   TEST(MemoryGroup),
+  TEST(HashConsingTest),
+  TEST(DeferredDestroyTest),
+  TEST(OwnTest),
+  TEST(SortMonosTest),
+  TEST(DenseMulNttTest),
+  TEST(FlatTest),
 };
 
 int main() {
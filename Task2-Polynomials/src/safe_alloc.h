@@ -0,0 +1,41 @@
+/** @file
+ * Bezpieczna alokacja pamięci, przez warstwę alokacji wspólną z Task1 (alloc.h).
+ *
+ * Nagłówek wewnętrzny: używają go pliki biblioteki, kalkulatora i benchmarku,
+ * a interfejs poly.h nie zależy od katalogu Common.
+
+  @author Mikołaj Uzarski
+  @date 2021
+*/
+
+#ifndef __SAFE_ALLOC_H__
+#define __SAFE_ALLOC_H__
+
+#include "alloc.h"
+
+/**
+ * Bezpieczna alokacja pamięci.
+ * Program zostaje zakończony kodem 1 w przypadku braku pamięci.
+ * Makro, dzięki temu warstwa zna miejsce wywołania.
+ * @param[in] size : rozmiar alokowanej pamięci
+ * @return void* : zaalokowany wskaźnik
+ */
+#define safeMalloc(size) alloc_malloc((size), ALLOC_SITE)
+
+/**
+ * Bezpieczna realokacja pamięci.
+ * Program zostaje zakończony kodem 1 w przypadku braku pamięci.
+ * @param[in] ptr : realokowany wskaźnik
+ * @param[in] size : rozmiar alokowanej pamięci
+ * @return void* : nowo zarealokowany wskaźnik
+ */
+#define safeRealloc(ptr, size) alloc_realloc((ptr), (size), ALLOC_SITE)
+
+/**
+ * Zwalnia pamięć zaalokowaną przez safeMalloc lub safeRealloc.
+ * Przyjmuje też pamięć zaalokowaną przez malloc (np. tablice przekazane do PolyOwnMonos).
+ * @param[in] ptr : zwalniany wskaźnik
+ */
+#define safeFree(ptr) alloc_free(ptr)
+
+#endif /* __SAFE_ALLOC_H__ */
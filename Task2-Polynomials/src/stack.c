@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <limits.h>
 #include "stack.h"
+#include "safe_alloc.h"
 
 /**
  * Wypisuje na standardowe wyjście wartość logiczną
@@ -55,17 +56,16 @@ static Poly StackPop(Stack *stack) {
 /**
  * Wykonuje operację dwuargumentową na dwóch wierzchnich wielomianach stosu @p stack.
  * @param[in] stack : stos
- * @param[in] op : wskaźnik na funkcję, która jest operacją dwuargumentową na wielomianach
+ * @param[in] op : wskaźnik na funkcję, która jest operacją dwuargumentową na wielomianach,
+ * przejmującą je na własność
  * @param[in] line : numer wiersza
  */
-static void StackTwoArgsOp(Stack *stack, Poly (*op)(const Poly *, const Poly *), size_t line) {
+static void StackTwoArgsOp(Stack *stack, Poly (*op)(Poly *, Poly *), size_t line) {
     if (!StackCheckUnderflow(stack, line, 2)) {
         assert(stack->size >= 2);
         Poly p = StackPop(stack);
         Poly q = StackPop(stack);
         Poly res = op(&p, &q);
-        PolyDestroy(&p);
-        PolyDestroy(&q);
         StackPut(stack, &res);
     }
 }
@@ -90,7 +90,7 @@ void StackDestroy(Stack *stack) {
     for (size_t i = 0; i < stack->size; i++) {
         PolyDestroy(&stack->polys[i]);
     }
-    free(stack->polys);
+    safeFree(stack->polys);
 }
 
 void StackPut(Stack *stack, const Poly *p) {
@@ -148,23 +148,22 @@ void StackClone(Stack *stack, size_t line) {
 }
 
 void StackAdd(Stack *stack, size_t line) {
-    StackTwoArgsOp(stack, PolyAdd, line);
+    StackTwoArgsOp(stack, PolyAddOwn, line);
 }
 
 void StackMul(Stack *stack, size_t line) {
-    StackTwoArgsOp(stack, PolyMul, line);
+    StackTwoArgsOp(stack, PolyMulOwn, line);
 }
 
 void StackSub(Stack *stack, size_t line) {
-    StackTwoArgsOp(stack, PolySub, line);
+    StackTwoArgsOp(stack, PolySubOwn, line);
 }
 
 void StackNeg(Stack *stack, size_t line) {
     if (!StackCheckUnderflow(stack, line, 1)) {
         assert(stack->size > 0);
         Poly p = StackPop(stack);
-        Poly neg = PolyNeg(&p);
-        PolyDestroy(&p);
+        Poly neg = PolyNegOwn(&p);
         StackPut(stack, &neg);
     }
 }
@@ -198,8 +197,7 @@ void StackAt(Stack *stack, poly_coeff_t x, size_t line) {
     if (!StackCheckUnderflow(stack, line, 1)) {
         assert(stack->size > 0);
         Poly p = StackPop(stack);
-        Poly res = PolyAt(&p, x);
-        PolyDestroy(&p);
+        Poly res = PolyAtOwn(&p, x);
         StackPut(stack, &res);
     }
 }
@@ -221,6 +219,6 @@ void StackCompose(Stack *stack, size_t k, size_t line) {
         for (size_t i = 0; i < k; i++) {
             PolyDestroy(&polys[i]);
         }
-        free(polys);
+        safeFree(polys);
     }
 }
\ No newline at end of file